@@ -0,0 +1,30 @@
+/// @brief A plain axis aligned bounding box, used for collision without needing a Tile
+#ifndef AABB_STRUCT
+#define AABB_STRUCT
+
+#include <glm/glm.hpp>
+
+struct AABB {
+    glm::vec2 min;   // bottom left
+    glm::vec2 max;   // top right
+
+    float left() const {return min.x;}
+    float right() const {return max.x;}
+    float bottom() const {return min.y;}
+    float top() const {return max.y;}
+};
+
+/// @brief Checks if two boxes are overlapping, return true if they are
+/// (a box touching the bottom of another from below counts as overlapping, the same as for Tiles)
+bool colliding(const AABB& box_one, const AABB& box_two) {
+    // check horizontal bounds
+    if (box_one.left() >= box_two.right() || box_one.right() <= box_two.left()) {return false;}  // not overlapping x
+
+    // check vertical bounds
+    if (box_one.top() < box_two.bottom() || box_one.bottom() >= box_two.top()) {return false;} // not overlapping y
+
+    return true;
+}
+
+#endif
+/* EOF */
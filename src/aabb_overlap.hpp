@@ -0,0 +1,273 @@
+/// @brief Tests one box against many at once. The many are packed as structure of arrays (every
+/// min x, then every min y, ...) so 4 or 8 of them load straight into SSE or AVX registers, and
+/// the answer comes back as a bitmask with a bit per box.
+///
+///     std::uint64_t hits;
+///     overlap_mask(player_box, cells.arrays(), cells.size(), &hits);
+///     for (; hits; hits &= hits - 1) { ... lowest_bit(hits) ... }
+///
+/// the widest kernel the CPU runs is picked once at startup, every kernel gives exactly the same
+/// answer as colliding(box, other) for each box, NaNs included, so physics stays deterministic
+/// whichever one runs. Not x86? Only the scalar kernel is built
+#ifndef AABB_OVERLAP
+#define AABB_OVERLAP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "aabb.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define AABB_OVERLAP_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and clang only emit SSE (on 32 bit) and AVX instructions inside functions marked for them, MSVC always can
+#if defined(AABB_OVERLAP_X86) && (defined(__GNUC__) || defined(__clang__))
+#define AABB_OVERLAP_SSE __attribute__((target("sse2")))
+#define AABB_OVERLAP_AVX2 __attribute__((target("avx2")))
+#else
+#define AABB_OVERLAP_SSE
+#define AABB_OVERLAP_AVX2
+#endif
+
+/// @brief the kernels, narrowest first
+enum class SimdLevel {
+    SCALAR,
+    SSE,        // 4 boxes at a time
+    AVX2,       // 8 boxes at a time
+};
+
+/// @brief the edges of many boxes, box i is (min_x[i], min_y[i]) to (max_x[i], max_y[i])
+struct BoxArrays {
+    const float* min_x;
+    const float* min_y;
+    const float* max_x;
+    const float* max_y;
+
+    /// @brief the boxes from index first on
+    BoxArrays from(std::size_t first) const {return BoxArrays{min_x + first, min_y + first, max_x + first, max_y + first};}
+};
+
+/// @brief set a bit of the mask for every box the box overlaps, the same test as colliding(box, boxes[i])
+/// @param box the box tested against all the others
+/// @param boxes the others
+/// @param count number of others
+/// @param mask [out] (count + 63) / 64 words, bit i % 64 of word i / 64 is box i. cleared first
+void overlap_mask(const AABB& box, const BoxArrays& boxes, std::size_t count, std::uint64_t* mask);
+
+/// @brief the widest kernel this CPU runs
+SimdLevel best_simd_level();
+
+/// @brief the kernel overlap_mask runs
+SimdLevel simd_level();
+
+/// @brief run another kernel from now on, eg to compare them. levels the CPU lacks fall back to the best it has.
+/// not safe while other threads call overlap_mask
+void set_simd_level(SimdLevel level);
+
+const char* simd_level_name(SimdLevel level);
+
+/// @brief the level named "scalar", "sse" or "avx2"
+/// @return false if the name is none of them
+bool simd_level_from_name(const std::string& name, SimdLevel& level);
+
+/// @brief index of the lowest set bit, the mask must not be 0
+int lowest_bit(std::uint64_t mask) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(mask);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return static_cast<int>(index);
+#else
+    int index = 0;
+    while (!(mask & 1)) {mask >>= 1; ++index;}
+    return index;
+#endif
+}
+
+/// @brief boxes packed for overlap_mask, eg trigger zones tested against the player every step
+class AABBBatch {
+public:
+    /// @brief add a box, it gets the next index
+    void add(const AABB& box) {
+        min_x.push_back(box.min.x);
+        min_y.push_back(box.min.y);
+        max_x.push_back(box.max.x);
+        max_y.push_back(box.max.y);
+    }
+
+    AABB get(std::size_t i) const {return AABB{glm::vec2(min_x[i], min_y[i]), glm::vec2(max_x[i], max_y[i])};}
+
+    void clear() {min_x.clear(); min_y.clear(); max_x.clear(); max_y.clear();}
+    void reserve(std::size_t count) {min_x.reserve(count); min_y.reserve(count); max_x.reserve(count); max_y.reserve(count);}
+    std::size_t size() const {return min_x.size();}
+
+    BoxArrays arrays() const {return BoxArrays{min_x.data(), min_y.data(), max_x.data(), max_y.data()};}
+
+    /// @brief every box of the batch overlapping a box, in index order
+    /// @param found [out] cleared, then filled with indices
+    void overlapping(const AABB& box, std::vector<std::uint32_t>& found) const;
+
+private:
+    std::vector<float> min_x;
+    std::vector<float> min_y;
+    std::vector<float> max_x;
+    std::vector<float> max_y;
+};
+
+void AABBBatch::overlapping(const AABB& box, std::vector<std::uint32_t>& found) const {
+    found.clear();
+
+    // a word of the mask at a time, so no allocation however many boxes there are
+    BoxArrays boxes = arrays();
+    for (std::size_t first = 0; first < size(); first += 64) {
+        std::size_t count = size() - first < 64 ? size() - first : 64;
+        std::uint64_t hits;
+        overlap_mask(box, boxes.from(first), count, &hits);
+        for (; hits; hits &= hits - 1) {found.push_back(static_cast<std::uint32_t>(first + lowest_bit(hits)));}
+    }
+}
+
+/// @brief the kernels themselves, called through overlap_mask
+namespace overlap_kernels {
+
+// a box is missed when colliding() would return false early: each test is the negation of one of its
+// comparisons. Ordered compares are false for NaN, just like colliding's, so a NaN edge never misses
+
+void scalar(const AABB& box, const BoxArrays& boxes, std::size_t first, std::size_t count, std::uint64_t* mask) {
+    for (std::size_t i = first; i < count; ++i) {
+        bool miss = box.min.x >= boxes.max_x[i] || box.max.x <= boxes.min_x[i] ||
+                    box.max.y < boxes.min_y[i] || box.min.y >= boxes.max_y[i];
+        if (!miss) {mask[i / 64] |= std::uint64_t(1) << (i % 64);}
+    }
+}
+
+#ifdef AABB_OVERLAP_X86
+AABB_OVERLAP_SSE
+void sse(const AABB& box, const BoxArrays& boxes, std::size_t count, std::uint64_t* mask) {
+    const __m128 left = _mm_set1_ps(box.min.x);
+    const __m128 right = _mm_set1_ps(box.max.x);
+    const __m128 bottom = _mm_set1_ps(box.min.y);
+    const __m128 top = _mm_set1_ps(box.max.y);
+
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 miss = _mm_or_ps(
+            _mm_or_ps(_mm_cmpge_ps(left, _mm_loadu_ps(boxes.max_x + i)), _mm_cmple_ps(right, _mm_loadu_ps(boxes.min_x + i))),
+            _mm_or_ps(_mm_cmplt_ps(top, _mm_loadu_ps(boxes.min_y + i)), _mm_cmpge_ps(bottom, _mm_loadu_ps(boxes.max_y + i))));
+
+        // 4 lanes never straddle a word, i is a multiple of 4
+        std::uint64_t hits = static_cast<std::uint64_t>(~_mm_movemask_ps(miss) & 0xf);
+        mask[i / 64] |= hits << (i % 64);
+    }
+    scalar(box, boxes, i, count, mask);
+}
+
+AABB_OVERLAP_AVX2
+void avx2(const AABB& box, const BoxArrays& boxes, std::size_t count, std::uint64_t* mask) {
+    const __m256 left = _mm256_set1_ps(box.min.x);
+    const __m256 right = _mm256_set1_ps(box.max.x);
+    const __m256 bottom = _mm256_set1_ps(box.min.y);
+    const __m256 top = _mm256_set1_ps(box.max.y);
+
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 miss = _mm256_or_ps(
+            _mm256_or_ps(_mm256_cmp_ps(left, _mm256_loadu_ps(boxes.max_x + i), _CMP_GE_OQ),
+                         _mm256_cmp_ps(right, _mm256_loadu_ps(boxes.min_x + i), _CMP_LE_OQ)),
+            _mm256_or_ps(_mm256_cmp_ps(top, _mm256_loadu_ps(boxes.min_y + i), _CMP_LT_OQ),
+                         _mm256_cmp_ps(bottom, _mm256_loadu_ps(boxes.max_y + i), _CMP_GE_OQ)));
+
+        // 8 lanes never straddle a word, i is a multiple of 8
+        std::uint64_t hits = static_cast<std::uint64_t>(~_mm256_movemask_ps(miss) & 0xff);
+        mask[i / 64] |= hits << (i % 64);
+    }
+    scalar(box, boxes, i, count, mask);
+}
+#endif
+
+/// @brief ask the CPU (and the OS, which has to save the wide registers) what it can run
+SimdLevel detect() {
+#if defined(AABB_OVERLAP_X86) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {return SimdLevel::AVX2;}
+    if (__builtin_cpu_supports("sse2")) {return SimdLevel::SSE;}
+    return SimdLevel::SCALAR;
+#elif defined(AABB_OVERLAP_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int highest = info[0];
+
+    __cpuid(info, 1);
+    bool sse2 = (info[3] & (1 << 26)) != 0;
+    bool os_saves_avx = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;     // OSXSAVE, then XMM and YMM state
+    bool avx2 = false;
+    if (highest >= 7 && os_saves_avx) {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+    if (avx2) {return SimdLevel::AVX2;}
+    return sse2 ? SimdLevel::SSE : SimdLevel::SCALAR;
+#else
+    return SimdLevel::SCALAR;
+#endif
+}
+
+SimdLevel best = detect();
+SimdLevel current = best;
+
+}   // namespace overlap_kernels
+
+void overlap_mask(const AABB& box, const BoxArrays& boxes, std::size_t count, std::uint64_t* mask) {
+    for (std::size_t word = 0; word < (count + 63) / 64; ++word) {mask[word] = 0;}
+
+#ifdef AABB_OVERLAP_X86
+    // too few boxes to fill the registers (a player's neighbouring tiles), touching the wide
+    // registers at all would cost more than the whole test
+    SimdLevel level = overlap_kernels::current;
+    if (level == SimdLevel::AVX2 && count >= 8) {
+        overlap_kernels::avx2(box, boxes, count, mask);
+        return;
+    }
+    if (level >= SimdLevel::SSE && count >= 4) {
+        overlap_kernels::sse(box, boxes, count, mask);
+        return;
+    }
+#endif
+    overlap_kernels::scalar(box, boxes, 0, count, mask);
+}
+
+SimdLevel best_simd_level() {return overlap_kernels::best;}
+
+SimdLevel simd_level() {return overlap_kernels::current;}
+
+void set_simd_level(SimdLevel level) {
+    overlap_kernels::current = level <= overlap_kernels::best ? level : overlap_kernels::best;
+}
+
+const char* simd_level_name(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::AVX2: return "avx2";
+    case SimdLevel::SSE: return "sse";
+    default: return "scalar";
+    }
+}
+
+bool simd_level_from_name(const std::string& name, SimdLevel& level) {
+    for (SimdLevel each : {SimdLevel::SCALAR, SimdLevel::SSE, SimdLevel::AVX2}) {
+        if (name == simd_level_name(each)) {
+            level = each;
+            return true;
+        }
+    }
+    return false;
+}
+
+#endif
+/* EOF */
@@ -0,0 +1,352 @@
+/// @brief Loads assets off the main thread. A pool of worker threads does the file reads and
+/// decoding (csv parsing, compiled map checks, ...) and hands each finished job back through a
+/// LockFreeQueue, so all the GL thread is left with is the upload and it never waits on a worker.
+///
+/// a job runs in up to three stages, each one optional:
+///     work    - on a worker, no GL calls
+///     upload  - GL calls. on the upload context thread if there is one and the job allows it,
+///               otherwise on the main thread from pump()
+///     ready   - on the main thread from pump(), once the upload is done and visible to it
+///
+/// the upload context is a hidden window sharing objects with the main one (see start_upload_context).
+/// Only buffers, textures, shaders and programs are shared between contexts, so jobs that make
+/// anything else (vertex arrays, framebuffers) have to leave shared_upload off
+#ifndef ASSET_LOADER_CLASS
+#define ASSET_LOADER_CLASS
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "lock_free_queue.hpp"
+#include "tile_grid.hpp"
+#include "map_binary.hpp"
+#include "trace.hpp"
+
+class AssetLoader {
+public:
+    struct Job {
+        std::function<void()> work;
+        std::function<void()> upload;
+        std::function<void()> ready;
+        bool shared_upload = false;     // upload only makes objects shared between contexts, so it may run on the upload context
+        GLsync fence = nullptr;         // set once an upload on the upload context has been issued
+    };
+
+    /// @brief most finished jobs waiting for the main thread before workers hold off
+    static const std::size_t FINISHED_CAPACITY = 1024;
+
+    /// @param worker_count threads doing file reads, 0 picks from the number of cores
+    explicit AssetLoader(int worker_count = 0);
+    ~AssetLoader();
+
+    AssetLoader(const AssetLoader&) = delete;
+    AssetLoader& operator=(const AssetLoader&) = delete;
+
+    /// @brief make a hidden window sharing objects with the main one, and a thread that uploads on it.
+    /// call from the main thread, with the main context current
+    /// @return false if the context could not be made, uploads then all happen in pump()
+    bool start_upload_context(GLFWwindow* main_window);
+
+    /// @brief queue a job, its work starts on the next free worker
+    void submit(Job job);
+
+    /// @brief read a whole file on a worker
+    /// @param done called on the main thread with the contents, and false if the file could not be read
+    void read_text(const std::string& path, std::function<void(std::string&&, bool)> done);
+
+    /// @brief load a map grid on a worker, through its compiled copy when that is up to date (see load_map)
+    /// @param done called on the main thread with the grid, and false if the map could not be loaded
+    void read_map(const std::string& path, bool verify_payload, std::function<void(TileGrid&&, bool)> done);
+
+    /// @brief run the upload and ready stages of finished jobs on the main thread.
+    /// call once per frame, with the main context current
+    /// @param budget_ms stop taking new jobs after this long, at least one job is always finished
+    /// @return jobs finished this call
+    int pump(double budget_ms = 4.0);
+
+    /// @brief jobs submitted whose ready stage has not run yet
+    int pending() const {return outstanding;}
+
+    int worker_count() const {return static_cast<int>(workers.size());}
+    bool has_upload_context() const {return upload_window != nullptr;}
+
+private:
+    /// @brief worker threads, run the work stage of queued jobs until told to stop
+    void run_worker();
+
+    /// @brief the upload context thread, runs shared uploads and fences them
+    void run_uploader();
+
+    /// @brief pass a job on to the main thread, waiting for room if the queue is full
+    void finish(Job* job);
+
+    /// @brief true if the GPU has finished the job's upload, or it had none on the upload context
+    static bool upload_done(Job* job);
+
+    int outstanding;                    // main thread only
+    std::vector<Job*> fenced;           // main thread only, jobs whose upload the GPU has not finished yet
+
+    LockFreeQueue<Job*> finished;       // workers and uploader -> main thread
+    std::atomic<bool> closing;          // the destructor has started, finished will not be emptied again
+
+    // workers sleep on this until there is work
+    std::vector<std::thread> workers;
+    std::mutex work_mutex;
+    std::condition_variable work_ready;
+    std::deque<Job*> work;
+    bool stopping;
+
+    // the upload context thread sleeps on this until there is an upload
+    GLFWwindow* upload_window;
+    std::thread uploader;
+    std::mutex upload_mutex;
+    std::condition_variable upload_ready;
+    std::deque<Job*> uploads;
+    bool stopping_uploads;
+};
+
+AssetLoader::AssetLoader(int worker_count)
+    : outstanding(0), finished(FINISHED_CAPACITY), closing(false), stopping(false), upload_window(nullptr), stopping_uploads(false) {
+    if (worker_count <= 0) {
+        // leave a core for the main thread, a few readers are plenty for disk bound work
+        int cores = static_cast<int>(std::thread::hardware_concurrency());
+        worker_count = std::max(1, std::min(cores - 1, 4));
+    }
+
+    for (int i = 0; i < worker_count; ++i) {
+        workers.emplace_back(&AssetLoader::run_worker, this);
+    }
+}
+
+AssetLoader::~AssetLoader() {
+    closing.store(true, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(work_mutex);
+        stopping = true;
+    }
+    work_ready.notify_all();
+    for (std::thread& worker : workers) {worker.join();}
+
+    if (uploader.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(upload_mutex);
+            stopping_uploads = true;
+        }
+        upload_ready.notify_all();
+        uploader.join();
+    }
+    if (upload_window) {glfwDestroyWindow(upload_window);}
+
+    // drop whatever never got to the main thread
+    for (Job* job : work) {delete job;}
+    for (Job* job : uploads) {delete job;}
+    Job* job = nullptr;
+    while (finished.pop(job)) {
+        if (job->fence) {glDeleteSync(job->fence);}
+        delete job;
+    }
+    for (Job* waiting : fenced) {
+        glDeleteSync(waiting->fence);
+        delete waiting;
+    }
+}
+
+bool AssetLoader::start_upload_context(GLFWwindow* main_window) {
+    if (upload_window) {return true;}
+
+    // the other hints (version, profile) are still the ones the main window was made with
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    upload_window = glfwCreateWindow(1, 1, "", nullptr, main_window);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+
+    if (upload_window == nullptr) {
+        std::cerr << "could not create an upload context, uploading on the main thread" << std::endl;
+        return false;
+    }
+
+    uploader = std::thread(&AssetLoader::run_uploader, this);
+    return true;
+}
+
+void AssetLoader::submit(Job job) {
+    ++outstanding;
+    {
+        std::lock_guard<std::mutex> lock(work_mutex);
+        work.push_back(new Job(std::move(job)));
+    }
+    work_ready.notify_one();
+}
+
+void AssetLoader::read_text(const std::string& path, std::function<void(std::string&&, bool)> done) {
+    struct Result {
+        std::string text;
+        bool ok = false;
+    };
+    std::shared_ptr<Result> result = std::make_shared<Result>();
+
+    Job job;
+    job.work = [path, result] {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {return;}
+
+        std::stringstream stream;
+        stream << file.rdbuf();
+        result->text = stream.str();
+        result->ok = true;
+    };
+    job.ready = [result, done] {done(std::move(result->text), result->ok);};
+    submit(std::move(job));
+}
+
+void AssetLoader::read_map(const std::string& path, bool verify_payload, std::function<void(TileGrid&&, bool)> done) {
+    struct Result {
+        TileGrid grid;
+        bool ok = false;
+    };
+    std::shared_ptr<Result> result = std::make_shared<Result>();
+
+    Job job;
+    job.work = [path, verify_payload, result] {result->ok = load_map(path, result->grid, verify_payload);};
+    job.ready = [result, done] {done(std::move(result->grid), result->ok);};
+    submit(std::move(job));
+}
+
+int AssetLoader::pump(double budget_ms) {
+    TRACE_SCOPE("AssetLoader::pump");
+
+    auto start = std::chrono::steady_clock::now();
+    auto out_of_time = [&] {
+        std::chrono::duration<double, std::milli> spent = std::chrono::steady_clock::now() - start;
+        return spent.count() >= budget_ms;
+    };
+
+    // jobs whose uploads the GPU had not finished by last frame go first
+    std::vector<Job*> ready_jobs;
+    std::vector<Job*> still_fenced;
+    for (Job* job : fenced) {
+        if (upload_done(job)) {ready_jobs.push_back(job);}
+        else {still_fenced.push_back(job);}
+    }
+    fenced.swap(still_fenced);
+
+    int done = 0;
+    auto run = [&](Job* job) {
+        if (job->upload) {job->upload();}
+        if (job->ready) {job->ready();}
+        delete job;
+        --outstanding;
+        ++done;
+    };
+
+    for (Job* job : ready_jobs) {run(job);}
+
+    Job* job = nullptr;
+    while ((done == 0 || !out_of_time()) && finished.pop(job)) {
+        if (!upload_done(job)) {
+            fenced.push_back(job);
+            continue;
+        }
+        run(job);
+    }
+    return done;
+}
+
+void AssetLoader::run_worker() {
+    while (true) {
+        Job* job;
+        {
+            std::unique_lock<std::mutex> lock(work_mutex);
+            work_ready.wait(lock, [this] {return stopping || !work.empty();});
+            if (stopping) {return;}
+
+            job = work.front();
+            work.pop_front();
+        }
+
+        if (job->work) {
+            TRACE_SCOPE("AssetLoader::work");
+            job->work();
+            job->work = nullptr;
+        }
+
+        if (job->upload && job->shared_upload && upload_window) {
+            {
+                std::lock_guard<std::mutex> lock(upload_mutex);
+                uploads.push_back(job);
+            }
+            upload_ready.notify_one();
+        }
+        else {
+            finish(job);
+        }
+    }
+}
+
+void AssetLoader::run_uploader() {
+    glfwMakeContextCurrent(upload_window);
+
+    while (true) {
+        Job* job;
+        {
+            std::unique_lock<std::mutex> lock(upload_mutex);
+            upload_ready.wait(lock, [this] {return stopping_uploads || !uploads.empty();});
+            if (stopping_uploads) {break;}
+
+            job = uploads.front();
+            uploads.pop_front();
+        }
+
+        {
+            TRACE_SCOPE("AssetLoader::upload");
+            job->upload();
+            job->upload = nullptr;
+        }
+
+        // the main context may only use the objects once the GPU has run the upload
+        job->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+        finish(job);
+    }
+
+    glfwMakeContextCurrent(nullptr);
+}
+
+void AssetLoader::finish(Job* job) {
+    // the main thread empties the queue every frame, so it is only ever full for a moment.
+    // unless it is shutting down, then nothing will empty it again
+    while (!finished.push(std::move(job))) {
+        if (closing.load(std::memory_order_relaxed)) {
+            if (job->fence) {glDeleteSync(job->fence);}
+            delete job;
+            return;
+        }
+        std::this_thread::yield();
+    }
+}
+
+bool AssetLoader::upload_done(Job* job) {
+    if (job->fence == nullptr) {return true;}
+
+    GLenum status = glClientWaitSync(job->fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {return false;}
+
+    glDeleteSync(job->fence);
+    job->fence = nullptr;
+    return true;
+}
+
+#endif
+/* EOF */
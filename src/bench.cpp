@@ -0,0 +1,397 @@
+/// @brief CPU microbenchmarks for the code that runs every frame or on every load.
+/// Needs no window or GL context. Each benchmark is run in batches long enough to time,
+/// and the median and fastest batch are reported per operation.
+///
+///     platformer_bench [--json=<file>] [--filter=<part of a name>] [--batches=<n>]
+///
+/// --json writes the results as json, so runs before and after a change can be compared
+#include <iostream>                         // push results to terminal
+#include <fstream>                          // write the json and the generated maps
+#include <chrono>                           // time the batches
+#include <functional>                       // std::function
+#include <algorithm>                        // sort the batch times
+#include <random>                           // fill the generated maps
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>                           // hardware_concurrency, for the threaded rows
+#include <glm/glm.hpp>                      // use mat4 and vec2
+#include "tile_grid.hpp"                    // map tiles
+#include "map_loader.hpp"                   // csv parsing
+#include "map_binary.hpp"                   // compiled maps
+#include "aabb.hpp"                         // colliding
+#include "entity_store.hpp"                 // actors as arrays
+#include "entity_systems.hpp"               // actor physics
+#include "player.hpp"                       // the player entity
+#include "spatial_hash.hpp"                 // entity versus entity broadphase
+#include "worker_pool.hpp"                  // threads for the physics step
+#include "aabb_overlap.hpp"                 // batched overlap kernels
+#include "input.hpp"                        // per-step input state
+#include "camera_view.hpp"                  // generate_view_matrix
+#include "view_rect.hpp"                    // visible_tiles
+
+/// @brief stop the compiler from removing work whose result is never used
+template <typename T>
+void keep(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "g"(&value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+struct BenchResult {
+    std::string name;
+    long long ops_per_batch;
+    int batches;
+    double median_ns;       // per operation
+    double min_ns;          // per operation
+    double ops_per_second;  // from the median
+};
+
+/// @brief a benchmark runs its operation `ops` times and returns how many it actually ran
+typedef std::function<long long(long long ops)> BenchBody;
+
+/// @brief time a benchmark, growing the batch until one takes at least 20 ms
+BenchResult run_bench(const std::string& name, const BenchBody& body, int batches);
+
+/// @brief write a csv map of width x height cells, about fill of them solid
+std::string write_csv_map(int width, int height, double fill, unsigned int seed);
+
+/// @brief a grid with a solid floor and about fill of the cells above it solid
+TileGrid make_grid(int width, int height, double fill, unsigned int seed);
+
+/// @brief run a player back and forth over a grid, jumping once a second
+long long run_player(const TileGrid& grid, long long ops);
+
+/// @brief write the results as json
+void write_json(std::ostream& out, const std::vector<BenchResult>& results);
+
+int main(int argc, char** argv) {
+    std::string json_path;
+    std::string filter;
+    int batches = 7;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 7, "--json=") == 0) {json_path = arg.substr(7);}
+        else if (arg.compare(0, 9, "--filter=") == 0) {filter = arg.substr(9);}
+        else if (arg.compare(0, 10, "--batches=") == 0) {batches = std::max(1, std::atoi(arg.c_str() + 10));}
+        else {std::cerr << "unknown option: " << arg << std::endl;}
+    }
+
+    std::vector<std::pair<std::string, BenchBody>> benches;
+    std::vector<std::string> generated;     // maps written for the run, removed at the end
+
+    // csv parsing, with the files written once up front so only the parse is timed
+    const int map_sizes[][2] = {{64, 36}, {256, 256}, {1024, 1024}};
+    for (const auto& size : map_sizes) {
+        std::string dimensions = std::to_string(size[0]) + "x" + std::to_string(size[1]);
+        std::string csv_name = "load_csv_map/" + dimensions;
+        std::string binary_name = "load_map_binary/" + dimensions;
+        bool csv_wanted = filter.empty() || csv_name.find(filter) != std::string::npos;
+        bool binary_wanted = filter.empty() || binary_name.find(filter) != std::string::npos;
+        if (!csv_wanted && !binary_wanted) {continue;}   // skip writing maps nothing reads
+
+        // the compiled map is made from the csv, so it is written for either row
+        std::string path = write_csv_map(size[0], size[1], 0.3, 1);
+        generated.push_back(path);
+        benches.emplace_back(csv_name, [path](long long ops) {
+            TileGrid grid;
+            for (long long i = 0; i < ops; ++i) {
+                load_csv_map(path, grid);
+                keep(grid);
+            }
+            return ops;
+        });
+
+        if (!binary_wanted) {continue;}
+
+        // the same map compiled, which is only a memory map and a header check
+        std::string compiled = compiled_map_path(path);
+        {
+            TileGrid grid;
+            load_csv_map(path, grid);
+            write_map_binary(compiled, grid, map_source_info(path));
+        }
+        generated.push_back(compiled);
+        benches.emplace_back(binary_name, [compiled](long long ops) {
+            TileGrid grid;
+            for (long long i = 0; i < ops; ++i) {
+                load_map_binary(compiled, grid, nullptr);
+                keep(grid);
+            }
+            return ops;
+        });
+    }
+
+    // the cells around the player, the lookup collision does every step
+    TileGrid dense = make_grid(1024, 64, 0.5, 2);
+    TileGrid sparse = make_grid(1024, 64, 0.0, 3);
+
+    benches.emplace_back("grid_neighbors/3x3", [&dense](long long ops) {
+        int count = 0;
+        for (long long i = 0; i < ops; ++i) {
+            int cx = 1 + static_cast<int>(i & 1023) % (dense.width() - 2);
+            int cy = 1 + static_cast<int>(i >> 10) % (dense.height() - 2);
+            for (int y = cy - 1; y <= cy + 1; ++y) {
+                for (int x = cx - 1; x <= cx + 1; ++x) {
+                    count += dense.solid(x, y) ? 1 : 0;
+                }
+            }
+        }
+        keep(count);
+        return ops;
+    });
+
+    benches.emplace_back("colliding", [](long long ops) {
+        AABB player = AABB{glm::vec2(3.2f, 1.0f), glm::vec2(3.7f, 1.75f)};
+        int hits = 0;
+        for (long long i = 0; i < ops; ++i) {
+            float x = static_cast<float>(i & 7);
+            AABB cell = AABB{glm::vec2(x, 1.0f), glm::vec2(x + 1.0f, 2.0f)};
+            keep(cell);
+            hits += colliding(player, cell) ? 1 : 0;
+        }
+        keep(hits);
+        return ops;
+    });
+
+    // one op is a box tested against 1024 packed boxes, with each kernel this CPU runs
+    AABBBatch packed;
+    for (int i = 0; i < 1024; ++i) {
+        glm::vec2 min = glm::vec2(static_cast<float>(i % 64), static_cast<float>(i / 64));
+        packed.add(AABB{min, min + glm::vec2(0.8f)});
+    }
+    for (SimdLevel level : {SimdLevel::SCALAR, SimdLevel::SSE, SimdLevel::AVX2}) {
+        if (level > best_simd_level()) {continue;}
+
+        benches.emplace_back(std::string("overlap_mask/1024/") + simd_level_name(level), [&packed, level](long long ops) {
+            set_simd_level(level);
+            std::uint64_t mask[1024 / 64];
+            for (long long i = 0; i < ops; ++i) {
+                glm::vec2 min = glm::vec2(static_cast<float>(i & 63), static_cast<float>((i >> 6) & 15));
+                keep(min);
+                overlap_mask(AABB{min, min + glm::vec2(1.5f)}, packed.arrays(), packed.size(), mask);
+                keep(mask);
+            }
+            set_simd_level(best_simd_level());
+            return ops;
+        });
+    }
+
+    benches.emplace_back("Player::move/dense", [&dense](long long ops) {return run_player(dense, ops);});
+    benches.emplace_back("Player::move/sparse", [&sparse](long long ops) {return run_player(sparse, ops);});
+
+    // one op is a whole simulation step of 50k walkers, the crowd the entity store is sized for
+    TileGrid crowd_grid = make_grid(1024, 256, 0.1, 4);
+    EntityStore crowd;
+    spawn_walkers(crowd, crowd_grid, TILE_SIZE, 50000);
+    benches.emplace_back("move_entities/50k", [&crowd, &crowd_grid](long long ops) {
+        for (long long i = 0; i < ops; ++i) {
+            walk_entities(crowd);
+            move_entities(crowd, crowd_grid, TILE_SIZE, 1.0f / 60.0f);
+        }
+        keep(crowd.box_min);
+        return ops;
+    });
+
+    // one op is a rebuild of the grid over the 50k walkers and a pass over every pair sharing a cell
+    SpatialHash crowd_hash(crowd_grid.width(), crowd_grid.height(), TILE_SIZE);
+    std::vector<SpatialHash::Pair> crowd_pairs;
+    benches.emplace_back("SpatialHash/50k", [&crowd, &crowd_hash, &crowd_pairs](long long ops) {
+        for (long long i = 0; i < ops; ++i) {
+            crowd_hash.rebuild(crowd);
+            crowd_hash.overlapping_pairs(crowd_pairs);
+            keep(crowd_pairs);
+        }
+        return ops;
+    });
+
+    // the same step and pair search on 2, 4, 8 ... threads, up to one per core. compare them with the
+    // single threaded rows on the machine in question, a single core machine has none
+    std::vector<std::unique_ptr<WorkerPool>> pools;
+    int cores = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    for (int threads = 2; threads <= cores; threads *= 2) {
+        pools.emplace_back(new WorkerPool(threads));
+        WorkerPool& pool = *pools.back();
+
+        std::string suffix = "/50k/threads=" + std::to_string(threads);
+        benches.emplace_back("move_entities" + suffix, [&pool, &crowd, &crowd_grid](long long ops) {
+            for (long long i = 0; i < ops; ++i) {
+                walk_entities(crowd);
+                move_entities(pool, crowd, crowd_grid, TILE_SIZE, 1.0f / 60.0f);
+            }
+            keep(crowd.box_min);
+            return ops;
+        });
+        benches.emplace_back("SpatialHash" + suffix, [&pool, &crowd, &crowd_hash, &crowd_pairs](long long ops) {
+            for (long long i = 0; i < ops; ++i) {
+                crowd_hash.rebuild(crowd);
+                crowd_hash.overlapping_pairs(pool, crowd_pairs);
+                keep(crowd_pairs);
+            }
+            return ops;
+        });
+    }
+
+    benches.emplace_back("generate_view_matrix", [](long long ops) {
+        glm::ivec2 map_size = glm::ivec2(1024, 64);
+        for (long long i = 0; i < ops; ++i) {
+            glm::vec2 pos = glm::vec2(static_cast<float>(i & 1023), static_cast<float>(i & 63));
+            keep(pos);
+            glm::mat4 view = generate_view_matrix(pos, map_size);
+            keep(view);
+        }
+        return ops;
+    });
+
+    benches.emplace_back("visible_tiles", [](long long ops) {
+        for (long long i = 0; i < ops; ++i) {
+            glm::vec2 camera = glm::vec2(static_cast<float>(i & 1023) * 0.25f, static_cast<float>(i & 63) * 0.25f);
+            keep(camera);
+            ViewRect rect = visible_tiles(camera, glm::vec2(NUM_OF_TILES_WIDTH, NUM_OF_TILES_HEIGHT), TILE_SIZE);
+            keep(rect);
+        }
+        return ops;
+    });
+
+    std::vector<BenchResult> results;
+    for (const auto& bench : benches) {
+        if (!filter.empty() && bench.first.find(filter) == std::string::npos) {continue;}
+
+        BenchResult result = run_bench(bench.first, bench.second, batches);
+        results.push_back(result);
+
+        std::printf("%-28s %14.1f ns/op (min %.1f)  %14.0f ops/s\n",
+                    result.name.c_str(), result.median_ns, result.min_ns, result.ops_per_second);
+    }
+
+    for (const std::string& path : generated) {std::remove(path.c_str());}
+
+    if (!json_path.empty()) {
+        std::ofstream out(json_path);
+        if (!out.is_open()) {
+            std::cerr << "could not write " << json_path << std::endl;
+            return -1;
+        }
+        write_json(out, results);
+    }
+
+    return 0;
+}
+
+BenchResult run_bench(const std::string& name, const BenchBody& body, int batches) {
+    typedef std::chrono::steady_clock Clock;
+    const double MIN_BATCH_SECONDS = 0.02;
+
+    // find a batch size that takes long enough to time, starting from one op
+    long long ops = 1;
+    while (true) {
+        auto start = Clock::now();
+        body(ops);
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        if (seconds >= MIN_BATCH_SECONDS || ops >= (1LL << 40)) {break;}
+
+        // jump most of the way there, but never more than 10x at a time
+        double scale = seconds > 0.0 ? MIN_BATCH_SECONDS * 1.2 / seconds : 10.0;
+        ops = static_cast<long long>(static_cast<double>(ops) * std::min(std::max(scale, 2.0), 10.0));
+    }
+
+    std::vector<double> times;
+    for (int batch = 0; batch < batches; ++batch) {
+        auto start = Clock::now();
+        long long ran = body(ops);
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        times.push_back(seconds * 1e9 / static_cast<double>(ran));
+    }
+    std::sort(times.begin(), times.end());
+
+    BenchResult result;
+    result.name = name;
+    result.ops_per_batch = ops;
+    result.batches = batches;
+    result.median_ns = times[times.size() / 2];
+    result.min_ns = times.front();
+    result.ops_per_second = result.median_ns > 0.0 ? 1e9 / result.median_ns : 0.0;
+    return result;
+}
+
+std::string write_csv_map(int width, int height, double fill, unsigned int seed) {
+    std::string path = "bench_map_" + std::to_string(width) + "x" + std::to_string(height) + ".csv";
+
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    std::uniform_int_distribution<int> tile(1, 6);
+
+    std::ofstream out(path);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            if (x > 0) {out << ',';}
+            out << (chance(random) < fill ? tile(random) : 0);
+        }
+        out << '\n';
+    }
+    return path;
+}
+
+TileGrid make_grid(int width, int height, double fill, unsigned int seed) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+
+    TileGrid grid(width, height);
+    for (int x = 0; x < width; ++x) {
+        grid.set(x, 0, 1);
+        for (int y = 1; y < height; ++y) {
+            if (chance(random) < fill) {grid.set(x, y, 2);}
+        }
+    }
+    return grid;
+}
+
+long long run_player(const TileGrid& grid, long long ops) {
+    const float step = 1.0f / 60.0f;
+
+    EntityStore entities;
+    long long i = 0;
+    while (i < ops) {
+        // start over whenever the player walks off the grid or falls out of it
+        Player player(entities, glm::vec2(3.0f, 1.0f));
+        for (; i < ops; ++i) {
+            InputState input;
+            input.right = (i / 180) % 2 == 0;
+            input.left = !input.right;
+            input.jump = i % 60 == 0;
+            apply_input(input, player);
+            move_entities(entities, grid, TILE_SIZE, step);
+
+            glm::vec2 pos = player.pos();
+            if (pos.x < 1.0f || pos.x > static_cast<float>(grid.width() - 2) || pos.y < 0.0f) {
+                ++i;
+                break;
+            }
+        }
+        keep(player);
+    }
+    return ops;
+}
+
+void write_json(std::ostream& out, const std::vector<BenchResult>& results) {
+    out << "{\n  \"benchmarks\": [\n";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& result = results[i];
+        out << "    {\"name\": \"" << result.name << "\""
+            << ", \"ops_per_batch\": " << result.ops_per_batch
+            << ", \"batches\": " << result.batches
+            << ", \"median_ns\": " << result.median_ns
+            << ", \"min_ns\": " << result.min_ns
+            << ", \"ops_per_second\": " << result.ops_per_second << "}"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+}
+
+/* EOF */
@@ -0,0 +1,72 @@
+/// @brief The camera matrices shared by every shader through one std140 uniform block.
+/// Written once per frame, then read by every program bound to CAMERA_BLOCK_BINDING,
+/// instead of each program getting its own copy of the projection and view matrices
+#ifndef CAMERA_CLASS
+#define CAMERA_CLASS
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include "shader.hpp"           // CAMERA_BLOCK_BINDING
+
+/// @brief matches the std140 layout of the Camera block in the shaders
+/// (three column-major mat4s, each 64 bytes with no padding)
+struct CameraBlock {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::mat4 view_projection;    // projection * view, so the shader only does one multiply
+};
+
+class CameraBuffer {
+public:
+    CameraBuffer(glm::mat4 projection);
+    ~CameraBuffer();
+
+    /// @brief upload the view matrix for this frame, call once after generate_view_matrix
+    /// @param view the view matrix from generate_view_matrix
+    void update(glm::mat4 view);
+
+    /// @brief change the projection, takes effect on the next update
+    void set_projection(glm::mat4 projection) {block.projection = projection;}
+
+    /// @brief the matrices as of the last update
+    const CameraBlock& matrices() const {return block;}
+
+    /// @brief bind the buffer back to CAMERA_BLOCK_BINDING, after something else (eg the profiler overlay) used it
+    void bind() const {glBindBufferBase(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, UBO);}
+
+private:
+    unsigned int UBO;
+    CameraBlock block;
+};
+
+CameraBuffer::CameraBuffer(glm::mat4 projection) {
+    block.projection = projection;
+    block.view = glm::mat4(1.0f);
+    block.view_projection = projection;
+
+    UBO = 0;
+    glGenBuffers(1, &UBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBlock), &block, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    // every program links its Camera block to this binding point (see Shader::bind_uniform_blocks)
+    glBindBufferBase(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, UBO);
+}
+
+CameraBuffer::~CameraBuffer() {
+    glDeleteBuffers(1, &UBO);
+}
+
+void CameraBuffer::update(glm::mat4 view) {
+    block.view = view;
+    block.view_projection = block.projection * view;
+
+    glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraBlock), &block);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+#endif
+/* EOF */
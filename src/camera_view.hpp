@@ -0,0 +1,52 @@
+/// @brief Camera logic with no GL in it: where the camera sits for a given player
+/// position and the view matrix that goes with it. Shared by the game and the headless runner
+#ifndef CAMERA_VIEW
+#define CAMERA_VIEW
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+// global constants
+const float TILE_SIZE = 1.0f;
+const float NUM_OF_TILES_WIDTH = 16.0f;
+const float NUM_OF_TILES_HEIGHT = 9.0f;
+
+/// @brief find the bottom left of the camera, centered on the player but locked to the map edges
+/// @param player_pos The center of the player object
+/// @param map_size The (width, height) in tiles of the map (assumes (0,0) is bottom left)
+/// @return the bottom left corner of the screen in world space
+glm::vec2 camera_position(glm::vec2 player_pos, glm::ivec2 map_size);
+
+/// @brief generate the view matrix to center the player, or lock the camera to the map edges
+/// @param player_pos The center of the player object
+/// @param map_size The (width, height) in tiles of the map (assumes (0,0) is bottom left)
+/// @return the view matrix applied to all drawn objects to control the camera
+glm::mat4 generate_view_matrix(glm::vec2 player_pos, glm::ivec2 map_size);
+
+glm::vec2 camera_position(glm::vec2 player_pos, glm::ivec2 map_size) {
+
+    // check x is between 0 and map_size.x
+    float x;
+    if (player_pos.x - (NUM_OF_TILES_WIDTH / 2.0f) <= 0.0f) {x = 0.0f;}
+    else if (player_pos.x + (NUM_OF_TILES_WIDTH / 2.0f) >= static_cast<float>(map_size.x)) {x = static_cast<float>(map_size.x) - NUM_OF_TILES_WIDTH;}
+    else {x = player_pos.x - (NUM_OF_TILES_WIDTH / 2.0f);}
+
+    // check y is between 0 and map_size.y
+    float y;
+    if (player_pos.y - (NUM_OF_TILES_HEIGHT / 2.0f) <= 0.0f) {y = 0.0f;}
+    else if (player_pos.y + (NUM_OF_TILES_HEIGHT / 2.0f) >= static_cast<float>(map_size.y)) {y = static_cast<float>(map_size.y) - NUM_OF_TILES_HEIGHT;}
+    else {y = player_pos.y - NUM_OF_TILES_HEIGHT / 2.0f;}
+
+    return glm::vec2(x, y);
+}
+
+glm::mat4 generate_view_matrix(glm::vec2 player_pos, glm::ivec2 map_size) {
+
+    glm::vec2 camera = camera_position(player_pos, map_size);
+
+    //          look at          camera pos                          camera target                       up vector
+    return glm::lookAt(glm::vec3(camera.x, camera.y, 1.0f), glm::vec3(camera.x, camera.y, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+#endif
+/* EOF */
@@ -0,0 +1,182 @@
+/// @brief Every actor in the level (the player, walkers, ...) kept as structure of arrays.
+/// Each field lives in its own tightly packed array, indexed the same way, so a system that
+/// only needs positions and timers streams through just those and nothing else.
+///
+/// the arrays stay dense: removing an entity moves the last one into its place. So code outside
+/// the store holds EntityHandles instead of indices. A handle names a slot that remembers the
+/// entity's current index, plus a generation that changes whenever the slot is reused, so a handle
+/// to a removed entity is never mistaken for whatever took its slot
+#ifndef ENTITY_STORE_CLASS
+#define ENTITY_STORE_CLASS
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "aabb.hpp"
+
+/// @brief a stable reference to an entity, stays valid (or reports it is gone) however the arrays are reordered
+struct EntityHandle {
+    std::uint32_t slot = 0xffffffffu;
+    std::uint32_t generation = 0;
+
+    bool operator==(const EntityHandle& other) const {return slot == other.slot && generation == other.generation;}
+    bool operator!=(const EntityHandle& other) const {return !(*this == other);}
+};
+
+class EntityStore {
+public:
+    /// @brief bits of flags[]
+    enum Flag : std::uint8_t {
+        CAN_JUMP = 1 << 0,      // standing on something, a jump is allowed
+        JUMPED = 1 << 1,        // still rising from a jump
+        HIT_WALL = 1 << 2,      // the last horizontal move was stopped by a cell
+        WALKER = 1 << 3,        // walks on its own, turning at walls (see walk_entities)
+        FACING_LEFT = 1 << 4,   // the way a walker is heading
+    };
+
+    /// @brief add an entity, its arrays are appended to
+    /// @param pos bottom left corner
+    /// @param size (width, height) of its box
+    /// @param speed tiles per second it moves at
+    /// @param color what it is drawn with
+    /// @param flags starting Flag bits
+    EntityHandle create(glm::vec2 pos, glm::vec2 size, float speed, glm::vec3 color, std::uint8_t flags = CAN_JUMP);
+
+    /// @brief remove an entity, moving the last one into its place
+    /// @return false if the handle was already removed
+    bool destroy(EntityHandle handle);
+
+    /// @brief true if the handle still names an entity
+    bool alive(EntityHandle handle) const {
+        return handle.slot < slot_index.size() && slot_generation[handle.slot] == handle.generation &&
+               slot_index[handle.slot] != NO_INDEX;
+    }
+
+    /// @brief where an entity sits in the arrays right now, only good until the next destroy
+    std::size_t index_of(EntityHandle handle) const {return slot_index[handle.slot];}
+
+    /// @brief handle of the entity at an index
+    EntityHandle handle_at(std::size_t index) const {
+        std::uint32_t slot = owner[index];
+        return EntityHandle{slot, slot_generation[slot]};
+    }
+
+    /// @brief number of entities
+    std::size_t size() const {return box_min.size();}
+
+    /// @brief reserve room for this many entities, so creating them never reallocates
+    void reserve(std::size_t count);
+
+    /// @brief the box of an entity
+    AABB bounds(std::size_t index) const {return AABB{box_min[index], box_max[index]};}
+
+    // one entry per entity, all the same length and order
+    std::vector<glm::vec2> box_min;         // bottom left, where the entity is
+    std::vector<glm::vec2> box_max;         // top right
+    std::vector<glm::vec2> previous_min;    // box before the last move, for interpolation
+    std::vector<glm::vec2> previous_max;
+    std::vector<glm::vec2> extent;          // (width, height), boxes snap back to it after a collision
+    std::vector<float> dir_x;               // horizontal input for the next move, cleared by the move
+    std::vector<float> speed;               // tiles per second
+    std::vector<float> time_airborn;        // seconds since last on the ground or since the jump
+    std::vector<std::uint8_t> flags;        // Flag bits
+    std::vector<glm::vec3> color;
+
+private:
+    static constexpr std::uint32_t NO_INDEX = 0xffffffffu;
+
+    std::vector<std::uint32_t> owner;           // per entity, the slot naming it
+
+    std::vector<std::uint32_t> slot_index;      // per slot, index of its entity or NO_INDEX
+    std::vector<std::uint32_t> slot_generation; // per slot, bumped every time its entity is removed
+    std::vector<std::uint32_t> free_slots;
+};
+
+EntityHandle EntityStore::create(glm::vec2 pos, glm::vec2 entity_size, float entity_speed, glm::vec3 entity_color, std::uint8_t entity_flags) {
+    std::uint32_t slot;
+    if (!free_slots.empty()) {
+        slot = free_slots.back();
+        free_slots.pop_back();
+    } else {
+        slot = static_cast<std::uint32_t>(slot_index.size());
+        slot_index.push_back(NO_INDEX);
+        slot_generation.push_back(0);
+    }
+
+    slot_index[slot] = static_cast<std::uint32_t>(size());
+    owner.push_back(slot);
+
+    box_min.push_back(pos);
+    box_max.push_back(pos + entity_size);
+    previous_min.push_back(pos);
+    previous_max.push_back(pos + entity_size);
+    extent.push_back(entity_size);
+    dir_x.push_back(0.0f);
+    speed.push_back(entity_speed);
+    time_airborn.push_back(0.0f);
+    flags.push_back(entity_flags);
+    color.push_back(entity_color);
+
+    return EntityHandle{slot, slot_generation[slot]};
+}
+
+bool EntityStore::destroy(EntityHandle handle) {
+    if (!alive(handle)) {return false;}
+
+    std::size_t index = slot_index[handle.slot];
+    std::size_t last = size() - 1;
+
+    // fill the hole with the last entity, so the arrays stay dense
+    if (index != last) {
+        box_min[index] = box_min[last];
+        box_max[index] = box_max[last];
+        previous_min[index] = previous_min[last];
+        previous_max[index] = previous_max[last];
+        extent[index] = extent[last];
+        dir_x[index] = dir_x[last];
+        speed[index] = speed[last];
+        time_airborn[index] = time_airborn[last];
+        flags[index] = flags[last];
+        color[index] = color[last];
+
+        owner[index] = owner[last];
+        slot_index[owner[index]] = static_cast<std::uint32_t>(index);
+    }
+
+    box_min.pop_back();
+    box_max.pop_back();
+    previous_min.pop_back();
+    previous_max.pop_back();
+    extent.pop_back();
+    dir_x.pop_back();
+    speed.pop_back();
+    time_airborn.pop_back();
+    flags.pop_back();
+    color.pop_back();
+    owner.pop_back();
+
+    slot_index[handle.slot] = NO_INDEX;
+    ++slot_generation[handle.slot];
+    free_slots.push_back(handle.slot);
+    return true;
+}
+
+void EntityStore::reserve(std::size_t count) {
+    box_min.reserve(count);
+    box_max.reserve(count);
+    previous_min.reserve(count);
+    previous_max.reserve(count);
+    extent.reserve(count);
+    dir_x.reserve(count);
+    speed.reserve(count);
+    time_airborn.reserve(count);
+    flags.reserve(count);
+    color.reserve(count);
+    owner.reserve(count);
+    slot_index.reserve(count);
+    slot_generation.reserve(count);
+}
+
+#endif
+/* EOF */
@@ -0,0 +1,342 @@
+/// @brief The update loops run over an EntityStore every simulation step. Each one walks the
+/// arrays it needs from the first entity to the last, so the work stays a straight stream
+/// through memory however many actors there are. Holds no GL objects
+#ifndef ENTITY_SYSTEMS
+#define ENTITY_SYSTEMS
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+#include "aabb.hpp"
+#include "aabb_overlap.hpp"
+#include "entity_store.hpp"
+#include "hash.hpp"
+#include "trace.hpp"
+#include "worker_pool.hpp"
+
+/// @brief find the range of cells overlapping a box, clamped to the grid
+/// @return false if the box is completely outside the grid
+template <typename Grid>
+bool cell_range(const Grid& grid, const AABB& area, float tile_size, glm::ivec2& first, glm::ivec2& last) {
+    first = glm::ivec2(static_cast<int>(std::floor(area.left() / tile_size)), static_cast<int>(std::floor(area.bottom() / tile_size)));
+    last = glm::ivec2(static_cast<int>(std::floor(area.right() / tile_size)), static_cast<int>(std::floor(area.top() / tile_size)));
+
+    // cells outside the grid are never solid
+    if (first.x < 0) {first.x = 0;}
+    if (first.y < 0) {first.y = 0;}
+    if (last.x > grid.width() - 1) {last.x = grid.width() - 1;}
+    if (last.y > grid.height() - 1) {last.y = grid.height() - 1;}
+
+    return first.x <= last.x && first.y <= last.y;
+}
+
+template <typename Grid, typename Hit>
+void for_each_solid_overlap_packed(const Grid& grid, glm::ivec2 first, glm::ivec2 last, float tile_size, const AABB& area, Hit hit);
+
+/// @brief call hit(cell) with the box of every solid cell in a range that overlaps an area, row by row.
+/// a large range (a big or fast entity) packs its solid cells up to 64 at a time and tests them
+/// together (see overlap_mask), the few cells around a walking entity are quicker tested one by one
+template <typename Grid, typename Hit>
+void for_each_solid_overlap(const Grid& grid, glm::ivec2 first, glm::ivec2 last, float tile_size, const AABB& area, Hit hit) {
+    if ((last.x - first.x + 1) * (last.y - first.y + 1) < 16) {
+        for (int y = first.y; y <= last.y; ++y) {
+            for (int x = first.x; x <= last.x; ++x) {
+                if (grid.at(x, y) == 0) {continue;}
+
+                AABB cell = AABB{glm::vec2(x, y) * tile_size, glm::vec2(x + 1, y + 1) * tile_size};
+                if (colliding(area, cell)) {hit(cell);}
+            }
+        }
+        return;
+    }
+    for_each_solid_overlap_packed(grid, first, last, tile_size, area, hit);
+}
+
+/// @brief for_each_solid_overlap for large ranges, kept apart so its buffers do not weigh down the common case
+template <typename Grid, typename Hit>
+void for_each_solid_overlap_packed(const Grid& grid, glm::ivec2 first, glm::ivec2 last, float tile_size, const AABB& area, Hit hit) {
+    float min_x[64], min_y[64], max_x[64], max_y[64];
+    const BoxArrays cells = BoxArrays{min_x, min_y, max_x, max_y};
+    std::size_t packed = 0;
+
+    auto test_packed = [&]() {
+        std::uint64_t hits;
+        overlap_mask(area, cells, packed, &hits);
+        for (; hits; hits &= hits - 1) {
+            int i = lowest_bit(hits);
+            hit(AABB{glm::vec2(min_x[i], min_y[i]), glm::vec2(max_x[i], max_y[i])});
+        }
+        packed = 0;
+    };
+
+    for (int y = first.y; y <= last.y; ++y) {
+        for (int x = first.x; x <= last.x; ++x) {
+            if (grid.at(x, y) == 0) {continue;}
+
+            glm::vec2 cell_min = glm::vec2(x, y) * tile_size;
+            glm::vec2 cell_max = glm::vec2(x + 1, y + 1) * tile_size;
+            min_x[packed] = cell_min.x;
+            min_y[packed] = cell_min.y;
+            max_x[packed] = cell_max.x;
+            max_y[packed] = cell_max.y;
+            if (++packed == 64) {test_packed();}
+        }
+    }
+    if (packed > 0) {test_packed();}
+}
+
+/// @brief move one entity and collide it with any solid cells of the grid.
+/// the cells are looked up straight from the grid over the area the entity swept through,
+/// so a large delta_time can not carry it through a tile
+/// @param grid the static tiles to collide with, a TileGrid or anything with the same
+/// at(), width() and height() (eg a StreamingWorld)
+/// @param tile_size the size of a grid cell in world space
+/// @param delta_time dt to normalize movement speed
+template <typename Grid>
+void move_entity(EntityStore& entities, std::size_t i, const Grid& grid, float tile_size, float delta_time);
+
+/// @brief move every entity, see move_entity
+template <typename Grid>
+void move_entities(EntityStore& entities, const Grid& grid, float tile_size, float delta_time) {
+    TRACE_SCOPE("move_entities");
+
+    for (std::size_t i = 0; i < entities.size(); ++i) {
+        move_entity(entities, i, grid, tile_size, delta_time);
+    }
+}
+
+/// @brief fewest entities given to one task, so small crowds stay on the calling thread.
+/// a walker's move costs about 75 ns (move_entities/50k), so a task is some 40 us of work,
+/// large next to handing it to a pool thread, one lock and one condition variable wake up
+const std::size_t MIN_ENTITIES_PER_TASK = 512;
+
+/// @brief move every entity, split over the threads of a pool.
+/// a move only reads the static tiles and writes the entity's own slots, so the tasks share nothing
+/// and the result is bit for bit the same as moving them one after another.
+/// only that sameness has been checked, not the speed up on several cores, so the game keeps the
+/// step on the main thread unless --physics-threads asks for more
+template <typename Grid>
+void move_entities(WorkerPool& pool, EntityStore& entities, const Grid& grid, float tile_size, float delta_time) {
+    TRACE_SCOPE("move_entities");
+
+    // a few tasks per thread, so one that lands on a crowded stretch does not hold up the step
+    std::size_t count = entities.size();
+    std::size_t tasks = std::min(static_cast<std::size_t>(pool.thread_count()) * 4,
+                                 (count + MIN_ENTITIES_PER_TASK - 1) / MIN_ENTITIES_PER_TASK);
+    if (tasks <= 1) {
+        for (std::size_t i = 0; i < count; ++i) {move_entity(entities, i, grid, tile_size, delta_time);}
+        return;
+    }
+
+    pool.run(static_cast<int>(tasks), [&](int task) {
+        std::size_t begin = count * static_cast<std::size_t>(task) / tasks;
+        std::size_t end = count * static_cast<std::size_t>(task + 1) / tasks;
+        for (std::size_t i = begin; i < end; ++i) {move_entity(entities, i, grid, tile_size, delta_time);}
+    });
+}
+
+/// @brief steer every WALKER, turning around when the last move ran it into a wall
+void walk_entities(EntityStore& entities) {
+    for (std::size_t i = 0; i < entities.size(); ++i) {
+        std::uint8_t& flags = entities.flags[i];
+        if (!(flags & EntityStore::WALKER)) {continue;}
+
+        if (flags & EntityStore::HIT_WALL) {flags ^= EntityStore::FACING_LEFT;}
+        entities.dir_x[i] = (flags & EntityStore::FACING_LEFT) ? -1.0f : 1.0f;
+    }
+}
+
+/// @brief turn walkers that ran into another entity around, each heading away from what it hit
+/// @param pairs entity indices whose boxes overlap, eg from SpatialHash::overlapping_pairs
+void bump_walkers(EntityStore& entities, const std::vector<std::pair<std::uint32_t, std::uint32_t>>& pairs) {
+    for (const auto& pair : pairs) {
+        float first_x = entities.box_min[pair.first].x + entities.box_max[pair.first].x;
+        float second_x = entities.box_min[pair.second].x + entities.box_max[pair.second].x;
+
+        const std::uint32_t both[2] = {pair.first, pair.second};
+        for (std::uint32_t i : both) {
+            std::uint8_t& flags = entities.flags[i];
+            if (!(flags & EntityStore::WALKER)) {continue;}
+
+            // face away, and drop any wall hit so walk_entities does not turn it right back
+            bool left_of_other = (i == pair.first) ? first_x <= second_x : second_x < first_x;
+            if (left_of_other) {flags |= EntityStore::FACING_LEFT;}
+            else {flags &= static_cast<std::uint8_t>(~EntityStore::FACING_LEFT);}
+            flags &= static_cast<std::uint8_t>(~EntityStore::HIT_WALL);
+        }
+    }
+}
+
+/// @brief remove every entity that fell below a height, except one
+/// @param floor_y entities whose top is below this are removed
+/// @param keep never removed, eg the player
+/// @return number removed
+int destroy_fallen(EntityStore& entities, float floor_y, EntityHandle keep) {
+    int removed = 0;
+
+    // walk backwards, so the entity moved into a hole has already been looked at
+    for (std::size_t i = entities.size(); i-- > 0;) {
+        if (entities.box_max[i].y >= floor_y) {continue;}
+
+        EntityHandle handle = entities.handle_at(i);
+        if (handle == keep) {continue;}
+
+        entities.destroy(handle);
+        ++removed;
+    }
+    return removed;
+}
+
+/// @brief add walkers on empty cells of the grid, scattered the same way every time for a given seed
+/// @param count walkers to add, fewer are added if the grid has too little room
+/// @return number added
+template <typename Grid>
+int spawn_walkers(EntityStore& entities, const Grid& grid, float tile_size, int count, std::uint32_t seed = 1) {
+    if (grid.width() < 3 || grid.height() < 3) {return 0;}
+
+    entities.reserve(entities.size() + static_cast<std::size_t>(count));
+
+    // xorshift, so the same seed spawns the same walkers on every platform
+    std::uint32_t state = seed ? seed : 1;
+    auto next = [&state] {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    };
+
+    int added = 0;
+    for (int attempt = 0; attempt < count * 8 && added < count; ++attempt) {
+        int x = 1 + static_cast<int>(next() % static_cast<std::uint32_t>(grid.width() - 2));
+        int y = 1 + static_cast<int>(next() % static_cast<std::uint32_t>(grid.height() - 2));
+        if (grid.at(x, y) != 0) {continue;}
+
+        std::uint8_t flags = EntityStore::CAN_JUMP | EntityStore::WALKER;
+        if (next() & 1) {flags |= EntityStore::FACING_LEFT;}
+
+        glm::vec2 pos = (glm::vec2(x, y) + 0.3f) * tile_size;
+        entities.create(pos, glm::vec2(0.4f) * tile_size, 1.5f, glm::vec3(0.9f, 0.6f, 0.2f), flags);
+        ++added;
+    }
+    return added;
+}
+
+/// @brief let an entity jump, if it is allowed to
+void entity_jump(EntityStore& entities, std::size_t i) {
+    if (!(entities.flags[i] & EntityStore::CAN_JUMP)) {return;}  // early return if no jump
+
+    entities.flags[i] |= EntityStore::JUMPED;
+    entities.time_airborn[i] = 0.0f;
+}
+
+/// @brief fingerprint of everything that affects an entity's next move, used to check replays stay deterministic
+std::uint64_t entity_state_hash(const EntityStore& entities, std::size_t i) {
+    bool can_jump = (entities.flags[i] & EntityStore::CAN_JUMP) != 0;
+    bool jumped = (entities.flags[i] & EntityStore::JUMPED) != 0;
+
+    // hash the exact bits of every float, any drift at all changes the hash
+    std::uint64_t hash = fnv1a_value(entities.box_min[i].x);
+    hash = fnv1a_value(entities.box_min[i].y, hash);
+    hash = fnv1a_value(entities.box_max[i].x, hash);
+    hash = fnv1a_value(entities.box_max[i].y, hash);
+    hash = fnv1a_value(entities.dir_x[i], hash);
+    hash = fnv1a_value(entities.time_airborn[i], hash);
+    hash = fnv1a_value(can_jump, hash);
+    hash = fnv1a_value(jumped, hash);
+    return hash;
+}
+
+template <typename Grid>
+void move_entity(EntityStore& entities, std::size_t i, const Grid& grid, float tile_size, float delta_time) {
+    glm::vec2& box_min = entities.box_min[i];
+    glm::vec2& box_max = entities.box_max[i];
+    glm::vec2 size = entities.extent[i];
+    float& dir_x = entities.dir_x[i];
+    float& time_airborn = entities.time_airborn[i];
+    std::uint8_t& flags = entities.flags[i];
+
+    entities.previous_min[i] = box_min;
+    entities.previous_max[i] = box_max;
+
+    // find how far to move x and y
+    float dx = dir_x * entities.speed[i] * delta_time;
+
+    const float OFFSET = 0.001f;  // small offset so not overlapping
+
+    glm::ivec2 first, last;
+
+    // Horizontal collisions
+    AABB start = AABB{box_min, box_max};
+    box_min.x += dx;
+    box_max.x += dx;
+
+    // check every cell between where the entity started and where it ended up
+    flags &= static_cast<std::uint8_t>(~EntityStore::HIT_WALL);
+    AABB swept = AABB{glm::min(start.min, box_min), glm::max(start.max, box_max)};
+    if (dir_x != 0.0f && cell_range(grid, swept, tile_size, first, last)) {
+        for_each_solid_overlap(grid, first, last, tile_size, swept, [&](const AABB& cell) {
+            // stop at the closest cell in the direction of movement
+            if (dir_x > 0.0f){ // moved right, stuck left
+                float right = cell.left() - OFFSET;
+                if (right < box_max.x) {box_min.x = right - size.x; box_max.x = right;}
+            } else {
+                float left = cell.right() + OFFSET;
+                if (left > box_min.x) {box_min.x = left; box_max.x = left + size.x;}
+            }
+            flags |= EntityStore::HIT_WALL;
+        });
+    }
+
+    // reset dir for next move frame
+    dir_x = 0.0f;
+
+    // using formula -32t + 10 (derivative of -16t&2 + 10t + h) to get per frame dy from 'gravity'
+    // if jumped, add vertical velocity, otherwise just falling
+    float dy = 0.0;
+    time_airborn += delta_time;
+    if (flags & EntityStore::JUMPED){
+        dy = (-32 * time_airborn) + 14;
+    } else {
+        dy = (-32 * time_airborn);
+    }
+
+    dy *= 0.5f * delta_time;
+
+    // move the box vertically
+    start = AABB{box_min, box_max};
+    box_min.y += dy;
+    box_max.y += dy;
+
+    swept = AABB{glm::min(start.min, box_min), glm::max(start.max, box_max)};
+    if (dy != 0.0f && cell_range(grid, swept, tile_size, first, last)) {
+        bool hit = false;
+        for_each_solid_overlap(grid, first, last, tile_size, swept, [&](const AABB& cell) {
+            if (dy > 0.0f){ // moved up, stuck bottom
+                float top = cell.bottom() - OFFSET;
+                if (!hit || top < box_max.y) {box_min.y = top - size.y; box_max.y = top;}
+            }
+            else { // fell, land on the highest cell
+                float bottom = cell.top();
+                if (!hit || bottom > box_min.y) {box_min.y = bottom; box_max.y = bottom + size.y;}
+            }
+            hit = true;
+        });
+
+        if (hit) {
+            if (dy < 0.0f){
+                // grounded, allow jumping again
+                flags |= EntityStore::CAN_JUMP;
+            }
+
+            // disable jumped, so no more upward velocity, reset time
+            flags &= static_cast<std::uint8_t>(~EntityStore::JUMPED);
+            time_airborn = 0.0f;
+        }
+    }
+}
+
+#endif
+/* EOF */
@@ -0,0 +1,64 @@
+/// @brief Runs the simulation at a fixed rate no matter how fast frames are drawn.
+/// Real frame time is added to an accumulator and spent in whole steps of step(),
+/// what is left over becomes alpha(), used to interpolate between the last two
+/// simulated states when drawing
+#ifndef FIXED_TIMESTEP_CLASS
+#define FIXED_TIMESTEP_CLASS
+
+class FixedTimestep {
+public:
+    /// @param sim_rate simulation steps per second
+    /// @param max_steps most steps run in one frame, any time past that is dropped
+    ///        so a long frame slows the game down instead of spiralling
+    FixedTimestep(float sim_rate = 60.0f, int max_steps = 5);
+
+    /// @brief add the real time of the last frame
+    /// @param frame_time seconds since the last call
+    /// @return number of simulation steps to run this frame
+    int advance(double frame_time);
+
+    /// @brief seconds simulated by each step
+    float step() const {return static_cast<float>(dt);}
+
+    /// @brief how far the render time is between the previous and the current step, 0 to 1
+    float alpha() const {return static_cast<float>(accumulator / dt);}
+
+    /// @brief number of steps dropped by the max_steps limit since the start
+    long long dropped_steps() const {return dropped;}
+
+    void set_sim_rate(float sim_rate) {dt = 1.0 / static_cast<double>(sim_rate);}
+    void set_max_steps(int steps) {max_steps = steps < 1 ? 1 : steps;}
+
+private:
+    double dt;
+    double accumulator;
+    int max_steps;
+    long long dropped;
+};
+
+FixedTimestep::FixedTimestep(float sim_rate, int max_steps) : accumulator(0.0), dropped(0) {
+    set_sim_rate(sim_rate);
+    set_max_steps(max_steps);
+}
+
+int FixedTimestep::advance(double frame_time) {
+    if (frame_time < 0.0) {frame_time = 0.0;}
+    accumulator += frame_time;
+
+    int steps = static_cast<int>(accumulator / dt);
+    if (steps > max_steps) {
+        dropped += steps - max_steps;
+        steps = max_steps;
+    }
+    accumulator -= steps * dt;
+
+    // throw away the backlog we will never catch up on, keep the fraction for alpha
+    if (accumulator >= dt) {
+        accumulator -= static_cast<int>(accumulator / dt) * dt;
+    }
+
+    return steps;
+}
+
+#endif
+/* EOF */
@@ -0,0 +1,240 @@
+/// @brief Measures how long each frame takes on the CPU, and how long each render pass
+/// takes on the GPU using GL_TIME_ELAPSED queries. Query results are read back
+/// LATENCY frames later, and only once the driver says they are ready, so the
+/// profiler never makes the CPU wait on the GPU. Results go to a rolling CSV log
+/// and are kept for the last WINDOW frames to give p50/p95/p99 frame times
+#ifndef FRAME_PROFILER_CLASS
+#define FRAME_PROFILER_CLASS
+
+#include <glad/glad.h>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+class FrameProfiler {
+public:
+    /// @brief the timed parts of a frame, in the order they happen
+    enum Pass {CLEAR, MAP, SPRITES, SWAP, PASS_COUNT};
+
+    /// @brief frames of queries kept in flight before their results are read
+    static const int LATENCY = 4;
+
+    /// @brief frame times kept for the percentiles
+    static const int WINDOW = 600;
+
+    /// @brief everything measured about one frame
+    struct FrameStats {
+        long long frame = -1;           // frame number, -1 until one has been measured
+        double cpu_ms = 0.0;            // CPU time from one begin_frame to the next
+        double gpu_ms[PASS_COUNT] = {}; // GPU time of each pass
+    };
+
+    /// @param csv_path file to log every frame to, empty for no log
+    /// @param csv_max_rows rows written before the log rolls over into <csv_path>.1
+    FrameProfiler(const std::string& csv_path = "", long long csv_max_rows = 100000);
+    ~FrameProfiler();
+
+    /// @brief call at the very start of a frame
+    void begin_frame();
+
+    /// @brief start and stop timing a pass on the GPU, passes must not overlap
+    void begin(Pass pass);
+    void end(Pass pass);
+
+    /// @brief call once all passes of the frame are done
+    void end_frame();
+
+    /// @brief the newest frame whose GPU times have come back
+    const FrameStats& latest() const {return last_resolved;}
+
+    /// @brief frame time percentile over the last WINDOW frames, in ms
+    /// @param percent 0 to 100, eg 99 for p99
+    double percentile(double percent) const;
+
+    /// @brief the last WINDOW cpu frame times in ms, oldest first
+    std::vector<double> history() const;
+
+    /// @brief name of a pass, used in the log and overlay
+    static const char* pass_name(int pass);
+
+private:
+    /// @brief read back every query of a slot if the GPU is done with it
+    /// @return false if the results are not ready yet
+    bool resolve(int slot);
+
+    /// @brief write a frame to the csv, rolling the file over when full
+    void log(const FrameStats& stats);
+
+    /// @brief open a new csv and write the header
+    void open_log();
+
+    unsigned int queries[LATENCY][PASS_COUNT];
+    bool pending[LATENCY];              // slot has queries waiting to be read
+    FrameStats in_flight[LATENCY];      // cpu side of the frames waiting on their queries
+
+    long long frame;
+    int slot;                           // slot used by the current frame
+    std::chrono::steady_clock::time_point frame_start;
+    bool started;
+
+    std::vector<double> frame_times;    // ring buffer of WINDOW cpu frame times
+    int frame_times_next;
+    int frame_times_count;
+
+    FrameStats last_resolved;
+
+    std::string csv_path;
+    std::FILE* csv;
+    long long csv_rows;
+    long long csv_max_rows;
+};
+
+FrameProfiler::FrameProfiler(const std::string& csv_path, long long csv_max_rows)
+    : frame(0), slot(0), started(false), frame_times(WINDOW, 0.0), frame_times_next(0), frame_times_count(0),
+      csv_path(csv_path), csv(nullptr), csv_rows(0), csv_max_rows(csv_max_rows) {
+
+    glGenQueries(LATENCY * PASS_COUNT, &queries[0][0]);
+    for (int i = 0; i < LATENCY; ++i) {pending[i] = false;}
+
+    if (!csv_path.empty()) {open_log();}
+}
+
+FrameProfiler::~FrameProfiler() {
+    glDeleteQueries(LATENCY * PASS_COUNT, &queries[0][0]);
+    if (csv != nullptr) {std::fclose(csv);}
+}
+
+void FrameProfiler::begin_frame() {
+    auto now = std::chrono::steady_clock::now();
+
+    // the time since the last begin_frame is the cpu time of the previous frame
+    if (started) {
+        double ms = std::chrono::duration<double, std::milli>(now - frame_start).count();
+        int previous = (slot + LATENCY - 1) % LATENCY;
+        in_flight[previous].cpu_ms = ms;
+
+        frame_times[frame_times_next] = ms;
+        frame_times_next = (frame_times_next + 1) % WINDOW;
+        if (frame_times_count < WINDOW) {++frame_times_count;}
+    }
+    frame_start = now;
+    started = true;
+
+    // this slot was used LATENCY frames ago, collect it if the GPU is done.
+    // if it still isn't, drop those results rather than wait on the GPU
+    if (pending[slot]) {
+        if (resolve(slot)) {
+            last_resolved = in_flight[slot];
+            log(last_resolved);
+        }
+        pending[slot] = false;
+    }
+
+    in_flight[slot] = FrameStats();
+    in_flight[slot].frame = frame;
+}
+
+void FrameProfiler::begin(Pass pass) {
+    glBeginQuery(GL_TIME_ELAPSED, queries[slot][pass]);
+}
+
+void FrameProfiler::end(Pass pass) {
+    (void)pass;  // only one GL_TIME_ELAPSED query can be active, so there is nothing to pick
+    glEndQuery(GL_TIME_ELAPSED);
+}
+
+void FrameProfiler::end_frame() {
+    pending[slot] = true;
+    slot = (slot + 1) % LATENCY;
+    ++frame;
+}
+
+bool FrameProfiler::resolve(int resolve_slot) {
+    // the last pass finishes last, if it is ready they all are
+    int available = 0;
+    glGetQueryObjectiv(queries[resolve_slot][PASS_COUNT - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {return false;}
+
+    for (int pass = 0; pass < PASS_COUNT; ++pass) {
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(queries[resolve_slot][pass], GL_QUERY_RESULT, &nanoseconds);
+        in_flight[resolve_slot].gpu_ms[pass] = static_cast<double>(nanoseconds) / 1.0e6;
+    }
+    return true;
+}
+
+double FrameProfiler::percentile(double percent) const {
+    if (frame_times_count == 0) {return 0.0;}
+
+    std::vector<double> sorted(frame_times.begin(), frame_times.begin() + frame_times_count);
+    std::size_t rank = static_cast<std::size_t>(percent / 100.0 * static_cast<double>(sorted.size() - 1) + 0.5);
+    if (rank >= sorted.size()) {rank = sorted.size() - 1;}
+
+    std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+    return sorted[rank];
+}
+
+std::vector<double> FrameProfiler::history() const {
+    std::vector<double> times;
+    times.reserve(frame_times_count);
+
+    int first = (frame_times_next - frame_times_count + WINDOW) % WINDOW;
+    for (int i = 0; i < frame_times_count; ++i) {
+        times.push_back(frame_times[(first + i) % WINDOW]);
+    }
+    return times;
+}
+
+const char* FrameProfiler::pass_name(int pass) {
+    static const char* names[PASS_COUNT] = {"clear", "map", "sprites", "swap"};
+    return (pass >= 0 && pass < PASS_COUNT) ? names[pass] : "unknown";
+}
+
+void FrameProfiler::open_log() {
+    csv = std::fopen(csv_path.c_str(), "w");
+    if (csv == nullptr) {
+        std::cerr << "could not open profiler log: " << csv_path << std::endl;
+        return;
+    }
+
+    std::fprintf(csv, "frame,cpu_ms");
+    for (int pass = 0; pass < PASS_COUNT; ++pass) {
+        std::fprintf(csv, ",gpu_%s_ms", pass_name(pass));
+    }
+    std::fprintf(csv, ",p50_ms,p95_ms,p99_ms\n");
+    csv_rows = 0;
+}
+
+void FrameProfiler::log(const FrameStats& stats) {
+    if (csv == nullptr) {return;}
+
+    // roll over so a long session can't fill the disk, keeping the previous file as .1
+    if (csv_rows >= csv_max_rows) {
+        std::fclose(csv);
+        csv = nullptr;
+        std::string previous = csv_path + ".1";
+        std::remove(previous.c_str());
+        std::rename(csv_path.c_str(), previous.c_str());
+        open_log();
+        if (csv == nullptr) {return;}
+    }
+
+    std::fprintf(csv, "%lld,%.4f", stats.frame, stats.cpu_ms);
+    for (int pass = 0; pass < PASS_COUNT; ++pass) {
+        std::fprintf(csv, ",%.4f", stats.gpu_ms[pass]);
+    }
+
+    // the percentiles sort the window, so only add them once a second or so
+    if (stats.frame % 60 == 0) {
+        std::fprintf(csv, ",%.4f,%.4f,%.4f\n", percentile(50.0), percentile(95.0), percentile(99.0));
+    } else {
+        std::fprintf(csv, ",,,\n");
+    }
+    ++csv_rows;
+}
+
+#endif
+/* EOF */
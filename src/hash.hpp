@@ -0,0 +1,31 @@
+/// @brief FNV-1a hashing, used wherever the game needs a cheap stable fingerprint of some bytes
+#ifndef HASH_FUNCTIONS
+#define HASH_FUNCTIONS
+
+#include <cstdint>
+#include <cstddef>
+
+const std::uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+const std::uint64_t FNV_PRIME = 1099511628211ULL;
+
+/// @brief 64 bit FNV-1a hash of a block of memory
+/// @param data the bytes to hash
+/// @param size number of bytes
+/// @param hash the hash to continue from, so several blocks can be chained
+std::uint64_t fnv1a(const void* data, std::size_t size, std::uint64_t hash = FNV_OFFSET_BASIS) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (std::size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+/// @brief hash the bytes of a plain value, eg a float or a struct of floats
+template <typename T>
+std::uint64_t fnv1a_value(const T& value, std::uint64_t hash = FNV_OFFSET_BASIS) {
+    return fnv1a(&value, sizeof(T), hash);
+}
+
+#endif
+/* EOF */
@@ -0,0 +1,170 @@
+/// @brief Runs the game simulation with no window and no GL context.
+/// Loads the map, then steps the player (and any --actors) physics and camera logic as fast as the CPU allows
+/// for --frames steps (or the length of a --replay recording), and reports how many
+/// frames per second that came to.
+/// Used to profile the simulation apart from rendering, and on machines with no display
+#include <iostream>                         // push results to terminal
+#include <chrono>                           // time the run
+#include <glm/glm.hpp>                      // use mat4 and vec2
+#include "tile_grid.hpp"                    // map tiles
+#include "map_binary.hpp"                   // load the compiled map, or the csv
+#include "streaming_world.hpp"              // levels streamed in around the player
+#include "entity_store.hpp"                 // every actor, the player included
+#include "entity_systems.hpp"               // actor physics
+#include "player.hpp"                       // the player entity
+#include "spatial_hash.hpp"                 // entity versus entity broadphase
+#include "worker_pool.hpp"                  // threads for the physics step
+#include "aabb_overlap.hpp"                 // pick the collision kernel
+#include "input.hpp"                        // per-step input state
+#include "camera_view.hpp"                  // camera position and view matrix
+#include "view_rect.hpp"                    // visible tile rect
+#include "options.hpp"                      // command line options
+#include "replay.hpp"                       // input recording and replay
+#include "trace.hpp"                        // cpu trace zones
+
+/// @brief a fixed input pattern, so every headless run does the same work
+/// @param step the number of the simulation step
+/// @param sim_rate simulation steps per second
+/// @return run right for 3 seconds then left for 3 seconds, jumping once a second
+InputState scripted_input(long long step, float sim_rate);
+
+int main(int argc, char** argv) {
+    Options options = parse_options(argc, argv);
+
+    // load the map with no GL, only the tile ids are needed
+    auto load_start = std::chrono::steady_clock::now();
+    TileGrid grid;
+    StreamingWorld world;
+    bool streaming = !options.world_path.empty();
+    if (streaming) {
+        if (!world.open(options.world_path, static_cast<std::size_t>(options.world_budget_mb * 1024.0f * 1024.0f), options.world_radius)) {
+            std::cout << "ERROR. WORLD FAILED TO LOAD: " << options.world_path << std::endl;
+            return -1;
+        }
+        // wait for every region near the player, so runs stay deterministic
+        world.set_blocking(true);
+    }
+    else if (!load_map(options.map_path, grid, options.verify_map)) {
+        std::cout << "ERROR. MAP FAILED TO LOAD: " << options.map_path << std::endl;
+        return -1;
+    }
+    auto load_end = std::chrono::steady_clock::now();
+
+    EntityStore entities;
+    Player player(entities, glm::vec2(3.0f * TILE_SIZE, 4.0f * TILE_SIZE));
+    if (options.actors > 0) {
+        if (streaming) {world.update(player.pos() / TILE_SIZE);}
+        int spawned = streaming ? spawn_walkers(entities, world, TILE_SIZE, options.actors)
+                                : spawn_walkers(entities, grid, TILE_SIZE, options.actors);
+        if (spawned < options.actors) {std::cout << "only room for " << spawned << " actors" << std::endl;}
+    }
+    glm::ivec2 map_size = streaming ? glm::ivec2(world.width(), world.height()) : glm::ivec2(grid.width(), grid.height());
+    float step = 1.0f / options.sim_rate;
+
+    // entities bumping into each other, found through cells laid over the map
+    SpatialHash broadphase(map_size.x, map_size.y, TILE_SIZE);
+    WorkerPool physics_pool(options.physics_threads);
+
+    // collision kernels, narrower ones are there to compare against
+    SimdLevel simd = best_simd_level();
+    if (!options.simd.empty() && !simd_level_from_name(options.simd, simd)) {
+        std::cerr << "unknown simd level: " << options.simd << std::endl;
+    }
+    set_simd_level(simd);
+    std::vector<SpatialHash::Pair> contacts;
+    long long contact_count = 0;
+
+    // a replay runs at the rate it was recorded at, for as many steps as it has
+    InputReplay replay;
+    if (!options.replay_path.empty()) {
+        if (!replay.open(options.replay_path)) {return -1;}
+        step = replay.step();
+    }
+
+    InputRecorder recorder;
+    if (!options.record_path.empty()) {
+        recorder.open(options.record_path, step);
+    }
+
+    // keep a running sum of the camera results so the work can't be optimized away
+    double checksum = 0.0;
+
+    long long frames = 0;
+    auto run_start = std::chrono::steady_clock::now();
+    while (replay.is_open() || frames < options.frames) {
+        TRACE_SCOPE("step");
+
+        InputState input;
+        if (replay.is_open()) {
+            if (!replay.next(input)) {break;}
+        } else {
+            input = scripted_input(frames, options.sim_rate);
+        }
+
+        apply_input(input, player);
+        walk_entities(entities);
+        if (streaming) {
+            world.update(player.pos() / TILE_SIZE);
+            move_entities(physics_pool, entities, world, TILE_SIZE, step);
+        } else {
+            move_entities(physics_pool, entities, grid, TILE_SIZE, step);
+        }
+        destroy_fallen(entities, -8.0f * TILE_SIZE, player.entity());  // fell out of the level
+
+        broadphase.rebuild(entities);
+        broadphase.overlapping_pairs(physics_pool, contacts);
+        bump_walkers(entities, contacts);
+        contact_count += static_cast<long long>(contacts.size());
+
+        if (replay.is_open()) {replay.verify(player.state_hash());}
+        recorder.record(input, player.state_hash());
+        ++frames;
+
+        glm::mat4 view = generate_view_matrix(player.pos(), map_size);
+        ViewRect visible = visible_tiles(camera_position(player.pos(), map_size),
+                                         glm::vec2(NUM_OF_TILES_WIDTH, NUM_OF_TILES_HEIGHT), TILE_SIZE);
+
+        checksum += view[3][0] + view[3][1] + visible.min_x + visible.min_y;
+    }
+    auto run_end = std::chrono::steady_clock::now();
+
+    double load_seconds = std::chrono::duration<double>(load_end - load_start).count();
+    double run_seconds = std::chrono::duration<double>(run_end - run_start).count();
+
+    std::cout << "map:           " << (streaming ? options.world_path : options.map_path) << " (" << map_size.x << " x " << map_size.y << ")\n"
+              << "load time:     " << load_seconds * 1000.0 << " ms\n"
+              << "frames:        " << frames << " at " << 1.0f / step << " Hz sim rate\n"
+              << "run time:      " << run_seconds * 1000.0 << " ms\n"
+              << "frames/second: " << (run_seconds > 0.0 ? static_cast<double>(frames) / run_seconds : 0.0) << "\n"
+              << "us/frame:      " << (frames > 0 ? run_seconds * 1e6 / static_cast<double>(frames) : 0.0) << "\n"
+              << "final pos:     (" << player.pos().x << ", " << player.pos().y << ")\n"
+              << "entities:      " << entities.size() << " (" << contact_count << " contacts, " << physics_pool.thread_count() << " physics threads, " << simd_level_name(simd_level()) << ")\n"
+              << "checksum:      " << checksum << std::endl;
+
+    if (streaming) {
+        std::cout << "regions:       " << world.resident_count() << " resident (" << world.resident_bytes() / 1024 << " KB)" << std::endl;
+    }
+
+    if (!options.trace_path.empty()) {TRACE_DUMP(options.trace_path);}
+
+    if (!options.replay_path.empty()) {
+        std::cout << "replay:        " << replay.step_count() << " steps, " << replay.mismatch_count() << " mismatched" << std::endl;
+        if (replay.mismatch_count() > 0) {return 1;}
+    }
+
+    return 0;
+}
+
+InputState scripted_input(long long step, float sim_rate) {
+    long long steps_per_second = static_cast<long long>(sim_rate);
+    if (steps_per_second < 1) {steps_per_second = 1;}
+
+    InputState input;
+    bool going_right = (step / (3 * steps_per_second)) % 2 == 0;
+    input.right = going_right;
+    input.left = !going_right;
+    input.jump = step % steps_per_second == 0;
+    return input;
+}
+
+/* EOF */
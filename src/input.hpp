@@ -0,0 +1,30 @@
+/// @brief The player input for one simulation step, kept apart from GLFW
+/// so the same state can come from the keyboard, a recording or a test
+#ifndef INPUT_STATE
+#define INPUT_STATE
+
+#include "player.hpp"
+
+struct InputState {
+    bool jump = false;
+    bool left = false;
+    bool right = false;
+};
+
+/// @brief feed one step of input to the player, run before every Player::move
+void apply_input(const InputState& input, Player& player) {
+    // jump check
+    if (input.jump) {
+        player.jump();
+    }
+
+    // check horizontal movement
+    if (input.left) {
+        player.move_left();
+    } if (input.right) {
+        player.move_right();
+    }
+}
+
+#endif
+/* EOF */
@@ -0,0 +1,119 @@
+/// @brief A fixed size queue that any number of threads can push to and pop from without locking.
+/// Each slot carries a sequence number that says whether it is ready to be written or read, so a
+/// push and a pop only ever contend on one atomic each (a bounded MPMC ring, after Dmitry Vyukov).
+/// Used to hand finished work back to the GL thread without it ever waiting on a mutex
+#ifndef LOCK_FREE_QUEUE_CLASS
+#define LOCK_FREE_QUEUE_CLASS
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+template <typename T>
+class LockFreeQueue {
+public:
+    /// @param capacity most values held at once, rounded up to a power of two
+    explicit LockFreeQueue(std::size_t capacity);
+
+    LockFreeQueue(const LockFreeQueue&) = delete;
+    LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+
+    /// @brief add a value to the back
+    /// @return false if the queue is full, the value is left untouched
+    bool push(T&& value);
+
+    /// @brief take the value at the front
+    /// @param value [out] set only if something was taken
+    /// @return false if the queue is empty
+    bool pop(T& value);
+
+    /// @brief true if nothing was queued at the time of the call, other threads may change that right after
+    bool empty() const;
+
+    std::size_t capacity() const {return mask + 1;}
+
+private:
+    struct Slot {
+        std::atomic<std::size_t> sequence;  // == position when free to write, == position + 1 when holding a value
+        T value;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    std::size_t mask;
+
+    // kept on separate cache lines so pushing and popping threads do not share one
+    alignas(64) std::atomic<std::size_t> push_pos;
+    alignas(64) std::atomic<std::size_t> pop_pos;
+};
+
+template <typename T>
+LockFreeQueue<T>::LockFreeQueue(std::size_t capacity) : push_pos(0), pop_pos(0) {
+    std::size_t size = 2;
+    while (size < capacity) {size *= 2;}
+    mask = size - 1;
+
+    slots.reset(new Slot[size]);
+    for (std::size_t i = 0; i < size; ++i) {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+template <typename T>
+bool LockFreeQueue<T>::push(T&& value) {
+    std::size_t pos = push_pos.load(std::memory_order_relaxed);
+    while (true) {
+        Slot& slot = slots[pos & mask];
+        std::size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+
+        if (diff == 0) {
+            // the slot is free, claim it before another pusher does
+            if (push_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                slot.value = std::move(value);
+                slot.sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (diff < 0) {
+            return false;   // still holding a value from a lap ago
+        }
+        else {
+            pos = push_pos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+template <typename T>
+bool LockFreeQueue<T>::pop(T& value) {
+    std::size_t pos = pop_pos.load(std::memory_order_relaxed);
+    while (true) {
+        Slot& slot = slots[pos & mask];
+        std::size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos + 1);
+
+        if (diff == 0) {
+            if (pop_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                value = std::move(slot.value);
+                // free for the push one lap from now
+                slot.sequence.store(pos + mask + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (diff < 0) {
+            return false;   // nothing written here yet
+        }
+        else {
+            pos = pop_pos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+template <typename T>
+bool LockFreeQueue<T>::empty() const {
+    std::size_t pos = pop_pos.load(std::memory_order_relaxed);
+    return slots[pos & mask].sequence.load(std::memory_order_acquire) != pos + 1;
+}
+
+#endif
+/* EOF */
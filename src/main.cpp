@@ -3,12 +3,29 @@
 #include <iostream>                         // push debug stuff to terminal
 #include <glm/glm.hpp>                      // use mat4 and vec2
 #include <vector>                           // use std::vector
-#include "tile.hpp"                         // use custom tile class
+#include <cmath>                            // circle the test sprites
+#include "sprite_batch.hpp"                 // draw everything that moves in one call
+#include "entity_store.hpp"                 // every actor, the player included
+#include "entity_systems.hpp"               // actor physics
 #include "player.hpp"                       // use custom player class
+#include "spatial_hash.hpp"                 // entity versus entity broadphase
+#include "worker_pool.hpp"                  // threads for the physics step
+#include "aabb_overlap.hpp"                 // pick the collision kernel
 #include "map.hpp"
-
-/// @todo - 
-///         images on tiles
+#include "streaming_world.hpp"               // levels streamed in around the player
+#include "streamed_map.hpp"
+#include "camera.hpp"                       // shared camera uniform buffer
+#include "camera_view.hpp"                  // camera position and view matrix
+#include "view_rect.hpp"                    // cull tiles outside the screen
+#include "input.hpp"                        // per-step input state
+#include "fixed_timestep.hpp"               // fixed rate simulation
+#include "options.hpp"                      // command line options
+#include "replay.hpp"                       // input recording and replay
+#include "frame_profiler.hpp"               // cpu and gpu frame timing
+#include "profiler_hud.hpp"                 // frame timing overlay
+#include "trace.hpp"                        // cpu trace zones
+#include "asset_loader.hpp"                 // read files off the main thread
+#include "tile_textures.hpp"                // images drawn on map tiles
 
 /// @brief create the window and initialize OpenGL, returning pointer to window
 /// @param width The width in pixels of the screen to be made
@@ -25,30 +42,35 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 
 /// @brief check inputs and determine what to do as a result
 /// @param window The window whose inputs are being checked
-/// @param player The player object whose direction in changed by user
-/// @param deltaTime used to make player movement speed consistent
-void processInput(GLFWwindow *window, Player& player, float deltaTime);
-
-/// @brief Find the 9 tiles around the player for collision detection
-/// @param surrounding_tiles a vector to store pointers to nearby tiles
-/// @param player_center the rounded position of the center of the player tile
-/// @param static_map the tile map containing all static tiles
-void determine_surrounding_tiles(std::vector<Tile*>& surrounding_tiles, glm::vec2 player_center, Map& static_map);
-
-/// @brief generate the view matrix to center the player, or lock the camera to the map edges
-/// @param player_pos The center of the player object
-/// @param map_size The (width, height) in tiles of the map (assumes (0,0) is bottom left)
-/// @return the view matrix applied to all drawn objects to control the camera
-glm::mat4 generate_view_matrix(glm::vec2 player_pos, glm::ivec2 map_size);
-
-// global constants
-const float TILE_SIZE = 1.0f;
-const float NUM_OF_TILES_WIDTH = 16.0f;
-const float NUM_OF_TILES_HEIGHT = 9.0f;
+/// @return the keys held this frame, applied to the player on every simulation step
+InputState processInput(GLFWwindow *window);
+
+/// @brief queue every entity, each part way between its last two steps
+/// @param batch the batch to add them to
+/// @param entities the actors to draw
+/// @param alpha how far between the previous and current step to draw (see FixedTimestep::alpha)
+void add_entity_sprites(SpriteBatch& batch, const EntityStore& entities, float alpha);
+
+/// @brief queue sprites circling a point, to see how the batch holds up under load
+/// @param batch the batch to add them to
+/// @param count number of sprites
+/// @param center the point they circle
+/// @param time seconds since start, moves them every frame
+void add_test_sprites(SpriteBatch& batch, int count, glm::vec2 center, float time);
+
+/// @brief read and cut up a tile sheet on the loader, then swap it in for the current tile images
+/// @param loader the loader to read it on, its upload context makes the texture when there is one
+/// @param textures the tile images to replace, must outlive the job
+/// @param sheet_path binary PPM tile sheet (see TileTextures::decode_sheet)
+void load_tile_sheet(AssetLoader& loader, TileTextures& textures, const std::string& sheet_path);
+
+// global constants, the world and view sizes live in camera_view.hpp
 const float SCREEN_W = 1024;
 const float SCREEN_H = 576;
 
-int main() {
+int main(int argc, char** argv) {
+    Options options = parse_options(argc, argv);
+
     // setup opengl
     GLFWwindow* window = setupWindow(static_cast<int>(SCREEN_W),static_cast<int>(SCREEN_H),"Grid Setup");
 
@@ -57,76 +79,306 @@ int main() {
         return -1;
     }
 
+    // linked shader programs are saved there, so later runs skip compiling them
+    ProgramBinaryCache::instance().set_directory(options.shader_cache);
+
     // setup orthogonal perspective
     glm::mat4 perspective = glm::ortho(0.0f,NUM_OF_TILES_WIDTH, 0.0f, NUM_OF_TILES_HEIGHT);
     
-    // create array of tiles
-    Map* static_map = new Map("/home/miles/dev/platformer/resources/maps/map.csv", TILE_SIZE, perspective);
+    // file reads and decoding happen on the loader's threads, the window stays responsive meanwhile
+    AssetLoader* loader = new AssetLoader(options.loader_threads);
+    if (options.upload_context) {loader->start_upload_context(window);}
+
+    // read the tile shaders ahead, the map, player and overlay all compile from them
+    const char* shader_paths[] = {"/home/miles/dev/platformer/src/tile_vertex.glsl", "/home/miles/dev/platformer/src/tile_fragment.glsl"};
+    for (const char* path : shader_paths) {
+        std::string shader_path = path;
+        loader->read_text(shader_path, [shader_path](std::string&& code, bool ok) {
+            if (ok) {ShaderCache::instance().add_file(shader_path, std::move(code));}
+        });
+    }
+
+    // the palette tiles until a sheet is read, one array texture holds every tile image
+    TileTextures* tile_textures = new TileTextures();
+    if (!options.tile_sheet.empty()) {load_tile_sheet(*loader, *tile_textures, options.tile_sheet);}
+
+    // create array of tiles once the loader has read it, or stream them in around the player with --world
+    Map* static_map = nullptr;
+    StreamingWorld* world = nullptr;
+    StreamedMap* world_map = nullptr;
+    std::vector<StreamingWorld::RegionEvent> region_events;
+    if (options.world_path.empty()) {
+        loader->read_map(options.map_path, options.verify_map, [&static_map, tile_textures](TileGrid&& grid, bool ok) {
+            static_map = new Map(std::move(grid), TILE_SIZE, !ok);
+            static_map->set_textures(tile_textures);
+        });
+    } else {
+        world = new StreamingWorld();
+        if (!world->open(options.world_path, static_cast<std::size_t>(options.world_budget_mb * 1024.0f * 1024.0f), options.world_radius)) {
+            std::cout << "ERROR. WORLD FAILED TO LOAD: " << options.world_path << std::endl;
+            delete loader;
+            return -1;
+        }
+        world_map = new StreamedMap(*world, TILE_SIZE);
+        world_map->set_textures(tile_textures);
+    }
+
 
+    // create Player, it lives in the store with every other actor
+    EntityStore* entities = new EntityStore();
+    Player* player = new Player(*entities, glm::vec2(3.0f * TILE_SIZE, 4.0f * TILE_SIZE));
 
-    // create Player
-    Player* player = new Player(glm::vec2(3.0f * TILE_SIZE, 4.0f * TILE_SIZE), perspective);
+    // the window is up already, wait only for the regions right around the player
+    if (world) {
+        world->set_blocking(true);
+        world->update(player->pos() / TILE_SIZE);    // the world streams in tiles
+        world->set_blocking(false);
+    }
+    SpriteBatch* sprites = nullptr;     // made once the shaders are in
+    SpatialHash* broadphase = nullptr;  // made once the map is in, it is sized from it
+    std::vector<SpatialHash::Pair> contacts;
+    WorkerPool* physics_pool = new WorkerPool(options.physics_threads);
+
+    // collision kernels, narrower ones are there to compare against
+    SimdLevel simd = best_simd_level();
+    if (!options.simd.empty() && !simd_level_from_name(options.simd, simd)) {
+        std::cerr << "unknown simd level: " << options.simd << std::endl;
+    }
+    set_simd_level(simd);
 
     // CREATE CAMERA
-    
+    CameraBuffer* camera = new CameraBuffer(perspective);
 
     // wireframe
     //glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
     float deltaTime = 0.0f;	// Time between current frame and last frame
     float lastFrame = 0.0f; // Time of last frame
-    float timeElapsed = 0.0f;  // time since last print statement
+
+    // frame timing, only created with --profile so a normal run issues no queries
+    FrameProfiler* profiler = nullptr;
+    ProfilerHud* hud = nullptr;
+    if (options.profile) {
+        profiler = new FrameProfiler(options.profile_log);
+        hud = new ProfilerHud("Grid Setup");
+    }
+
+    // the simulation runs in fixed steps, rendering runs as fast as it can
+    FixedTimestep timestep(options.sim_rate, options.max_steps);
+
+    // a replay has to run at the rate it was recorded at to stay deterministic
+    InputReplay replay;
+    if (!options.replay_path.empty() && replay.open(options.replay_path)) {
+        timestep.set_sim_rate(1.0f / replay.step());
+    }
+
+    InputRecorder recorder;
+    if (!options.record_path.empty()) {
+        recorder.open(options.record_path, timestep.step());
+    }
+#ifdef PLATFORMER_TRACE
+    bool dump_key_held = false;
+#endif
+
     // render loop
     while (!glfwWindowShouldClose(window))
     {
-   
+        TRACE_SCOPE("frame");
+
+        // finish whatever the loader threads have read, in a small slice of the frame
+        loader->pump();
+
+        // until the level and shaders are in there is nothing to simulate, just keep the window alive
+        if (sprites == nullptr) {
+            if (loader->pending() > 0) {
+                lastFrame = static_cast<float>(glfwGetTime());
+                processInput(window);
+                glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+                glClear(GL_COLOR_BUFFER_BIT);
+                glfwSwapBuffers(window);
+                glfwPollEvents();
+                continue;
+            }
+
+            // the level is in, so the actors can be placed on it
+            if (options.actors > 0) {
+                if (world) {spawn_walkers(*entities, *world, TILE_SIZE, options.actors);}
+                else {spawn_walkers(*entities, static_map->grid, TILE_SIZE, options.actors);}
+            }
+
+            if (world) {broadphase = new SpatialHash(world->width(), world->height(), TILE_SIZE);}
+            else {broadphase = new SpatialHash(static_map->width(), static_map->height(), TILE_SIZE);}
+
+            sprites = new SpriteBatch(entities->size() + static_cast<std::size_t>(options.sprite_test));
+        }
+
+        if (profiler) {profiler->begin_frame();}
+
         // update dt
         float currentFrame = static_cast<float>(glfwGetTime());
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
-        timeElapsed += currentFrame;
 
-        if(timeElapsed > 1000.0f) {
-            //std::cout << "FPS: " << (1.0f / deltaTime) << std::endl;
-            timeElapsed = 0.0f;
+
+        // input
+        InputState input;
+        {
+            TRACE_SCOPE("processInput");
+            input = processInput(window);
         }
 
+#ifdef PLATFORMER_TRACE
+        // F9 writes the trace so far, without having to quit
+        bool dump_key = glfwGetKey(window, GLFW_KEY_F9) == GLFW_PRESS;
+        if (dump_key && !dump_key_held && !options.trace_path.empty()) {TRACE_DUMP(options.trace_path);}
+        dump_key_held = dump_key;
+#endif
+
+        // run as many fixed steps as the frame time covers
+        int steps = timestep.advance(deltaTime);
+        for (int step = 0; step < steps; ++step) {
+            // a replay takes the place of the keyboard, through the same path
+            InputState step_input = input;
+            if (replay.is_open() && !replay.next(step_input)) {
+                glfwSetWindowShouldClose(window, true);
+                break;
+            }
 
-        // input
-        processInput(window, *player, deltaTime);
+            apply_input(step_input, *player);
+            walk_entities(*entities);
+
+            // move every actor and handle collision with static tiles, looked up straight from the grid
+            if (world) {move_entities(*physics_pool, *entities, *world, TILE_SIZE, timestep.step());}
+            else {move_entities(*physics_pool, *entities, static_map->grid, TILE_SIZE, timestep.step());}
+            destroy_fallen(*entities, -8.0f * TILE_SIZE, player->entity());  // fell out of the level
 
-        // determine the 9 cells around the player
-        std::vector<Tile*> surrounding_tiles;
-        determine_surrounding_tiles(surrounding_tiles, player->pos() / TILE_SIZE, *static_map);
+            // then against each other
+            broadphase->rebuild(*entities);
+            broadphase->overlapping_pairs(*physics_pool, contacts);
+            bump_walkers(*entities, contacts);
 
-        // move player and handle collision with static tiles
-        player->move(surrounding_tiles, deltaTime);
+            if (replay.is_open()) {replay.verify(player->state_hash());}
+            recorder.record(step_input, player->state_hash());
+        }
+
+        // draw the player part way between the last two steps so motion stays smooth at any refresh rate
+        float alpha = timestep.alpha();
+        glm::vec2 player_pos = player->interpolated_pos(alpha);
 
         // generate the view matrix                                     size of a row (aka x or width)  num of rows (aka y or height)
-        glm::mat4 view = generate_view_matrix(player->pos(), glm::ivec2(static_map->data.at(0).size(), static_map->data.size()));
+        glm::ivec2 map_size = world ? glm::ivec2(world->width(), world->height()) : glm::ivec2(static_map->width(), static_map->height());
+
+        // stream regions in around the player, and bake the ones that arrived
+        if (world) {
+            world->update(player->pos() / TILE_SIZE);
+            world->take_events(region_events);
+            world_map->update(region_events);
+            region_events.clear();
+        }
+        glm::mat4 view;
+        ViewRect visible;
+        {
+            TRACE_SCOPE("generate_view_matrix");
+            view = generate_view_matrix(player_pos, map_size);
+
+            // find the tiles on screen so the rest of the map can be skipped
+            visible = visible_tiles(camera_position(player_pos, map_size), 
+                                    glm::vec2(NUM_OF_TILES_WIDTH, NUM_OF_TILES_HEIGHT), TILE_SIZE);
+        }
+
+        // upload the camera once, every program reads it from the shared block
+        camera->update(view);
 
         // render stuff
+        if (profiler) {profiler->begin(FrameProfiler::CLEAR);}
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
+        if (profiler) {profiler->end(FrameProfiler::CLEAR);}
 
-        // /view = glm::mat4(1.0f);
         // draw map
-        static_map->draw(view);
+        if (profiler) {profiler->begin(FrameProfiler::MAP);}
+        if (world_map) {world_map->draw(visible);}
+        else {static_map->draw(visible);}
+        if (profiler) {profiler->end(FrameProfiler::MAP);}
+
+        // draw player, and anything else that moves, in one batch
+        if (profiler) {profiler->begin(FrameProfiler::SPRITES);}
+        add_entity_sprites(*sprites, *entities, alpha);
+        if (options.sprite_test > 0) {add_test_sprites(*sprites, options.sprite_test, player_pos, currentFrame);}
+        sprites->draw();
+        if (profiler) {profiler->end(FrameProfiler::SPRITES);}
+
+        // frame timing overlay, drawn over everything with its own camera
+        if (hud) {
+            hud->draw(*profiler);
+            camera->bind();
+            hud->update_title(window, *profiler, glfwGetTime());
+        }
+
+        if (profiler) {profiler->begin(FrameProfiler::SWAP);}
+        {
+            TRACE_SCOPE("glfwSwapBuffers");
+            glfwSwapBuffers(window);
+        }
+        if (profiler) {profiler->end(FrameProfiler::SWAP);}
+        {
+            TRACE_SCOPE("glfwPollEvents");
+            glfwPollEvents();
+        }
 
-        // draw player
-        player->draw(view);
-        
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        if (profiler) {profiler->end_frame();}
 
     }
     
-    // deallocate map memory
+    if (replay.is_open()) {
+        std::cout << "replay: " << replay.step_count() << " steps, " << replay.mismatch_count() << " mismatched" << std::endl;
+    }
+    if (recorder.is_open()) {
+        std::cout << "recorded " << recorder.step_count() << " steps to " << options.record_path << std::endl;
+    }
+
+    if (!options.trace_path.empty()) {TRACE_DUMP(options.trace_path);}
+
+    // stop the loader first, a level still loading is dropped
+    delete loader;
+    loader = nullptr;
+
+    // deallocate map memory, the chunks before the world they were baked from
     delete static_map;
     static_map = nullptr;
+    delete world_map;
+    world_map = nullptr;
+    delete world;
+    world = nullptr;
+
+    delete tile_textures;
+    tile_textures = nullptr;
 
-    // deallocate player
+    // deallocate player, then the store it lives in
     delete player;
     player = nullptr;
+    delete entities;
+    entities = nullptr;
+    delete broadphase;
+    broadphase = nullptr;
+    delete physics_pool;
+    physics_pool = nullptr;
+
+    delete sprites;
+    sprites = nullptr;
+
+    // deallocate camera
+    delete camera;
+    camera = nullptr;
+
+    // deallocate profiler, closing the log
+    if (profiler) {
+        std::cout << "frame time p50 " << profiler->percentile(50.0) << " ms, p95 " << profiler->percentile(95.0)
+                  << " ms, p99 " << profiler->percentile(99.0) << " ms" << std::endl;
+    }
+    delete hud;
+    hud = nullptr;
+    delete profiler;
+    profiler = nullptr;
 
     glfwTerminate();
     return 0;
@@ -171,62 +423,82 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
     glViewport(0, 0, width, height);
 }
 
-void processInput(GLFWwindow *window, Player& player, float deltaTime)
+void add_entity_sprites(SpriteBatch& batch, const EntityStore& entities, float alpha)
 {
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) 
-    {
-        glfwSetWindowShouldClose(window, true);
-    } 
-
-    // jump check
-    if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) {
-        player.jump();
+    for (std::size_t i = 0; i < entities.size(); ++i) {
+        glm::vec2 bottom_left = glm::mix(entities.previous_min[i], entities.box_min[i], alpha);
+        glm::vec2 top_right = glm::mix(entities.previous_max[i], entities.box_max[i], alpha);
+        batch.add(bottom_left, top_right - bottom_left, entities.color[i]);
     }
-    
-    
-    // check horizontal movement
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
-        player.move_left();
-    } if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
-        player.move_right();
-    }
-
 }
 
-
-void determine_surrounding_tiles(std::vector<Tile*>& surrounding_tiles, glm::vec2 player_center, Map& static_map) {
-
-    // find what tile the center of the player is on before move
-    glm::ivec2 center = glm::ivec2(static_cast<int>(player_center.x), static_cast<int>(player_center.y));
-
-    for (int y = -1; y < 2; ++y){
-        for (int x = - 1; x < 2; ++x){
-            // ensure not out of bounds - avoid invalid array access
-            if (center.y + y >= 0 && center.y + y < static_map.data.size() && center.x + x >= 0 && center.x + x < static_map.data.at(0).size()){
-                surrounding_tiles.push_back(static_map.data.at(center.y + y).at(center.x + x));
-            }
-        }
+void add_test_sprites(SpriteBatch& batch, int count, glm::vec2 center, float time)
+{
+    for (int i = 0; i < count; ++i) {
+        // spread them over rings, every ring turning at its own speed
+        float ring = 1.0f + static_cast<float>(i % 16) * 0.5f;
+        float angle = time * (0.5f + 0.1f * static_cast<float>(i % 7)) + static_cast<float>(i) * 2.39996f;
+        glm::vec2 pos = center + ring * glm::vec2(std::cos(angle), std::sin(angle));
+
+        float hue = static_cast<float>(i % 6) / 6.0f;
+        glm::vec3 color(0.5f + 0.5f * std::cos(6.2832f * hue), 0.5f + 0.5f * std::cos(6.2832f * (hue + 0.33f)),
+                        0.5f + 0.5f * std::cos(6.2832f * (hue + 0.67f)));
+        batch.add(pos, glm::vec2(0.25f, 0.25f), color);
     }
-
 }
 
-glm::mat4 generate_view_matrix(glm::vec2 player_pos, glm::ivec2 map_size) {
+void load_tile_sheet(AssetLoader& loader, TileTextures& textures, const std::string& sheet_path)
+{
+    struct Sheet {
+        std::vector<unsigned char> layers;
+        std::string error;
+        bool ok = false;
+        unsigned int texture = 0;
+    };
+    std::shared_ptr<Sheet> sheet = std::make_shared<Sheet>();
+
+    AssetLoader::Job job;
+    job.work = [sheet, sheet_path] {
+        std::vector<char> bytes;
+        if (!read_whole_file(sheet_path, bytes)) {sheet->error = "could not be read";}
+        else {sheet->ok = TileTextures::decode_sheet(bytes, sheet->layers, sheet->error);}
+    };
+
+    // only makes a texture, which the upload context shares with the main one
+    job.upload = [sheet] {
+        if (sheet->ok) {sheet->texture = TileTextures::create_texture(sheet->layers);}
+        sheet->layers = std::vector<unsigned char>();
+    };
+    job.shared_upload = true;
+
+    job.ready = [sheet, sheet_path, &textures] {
+        if (!sheet->ok) {
+            std::cout << "ERROR. TILE SHEET FAILED TO LOAD: " << sheet_path << ", " << sheet->error << std::endl;
+            return;
+        }
+        textures.replace(sheet->texture);
+    };
+    loader.submit(std::move(job));
+}
 
-    // check x is between 0 and map_size.x
-    float x;
-    if (player_pos.x - (NUM_OF_TILES_WIDTH / 2.0f) <= 0.0f) {x = 0.0f;}
-    else if (player_pos.x + (NUM_OF_TILES_WIDTH / 2.0f) >= static_cast<float>(map_size.x)) {x = static_cast<float>(map_size.x) - NUM_OF_TILES_WIDTH;}
-    else {x = player_pos.x - (NUM_OF_TILES_WIDTH / 2.0f);}
+InputState processInput(GLFWwindow *window)
+{
+    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) 
+    {
+        glfwSetWindowShouldClose(window, true);
+    } 
 
-    // check y is between 0 and map_size.y
-    float y;
-    if (player_pos.y - (NUM_OF_TILES_HEIGHT / 2.0f) <= 0.0f) {y = 0.0f;}
-    else if (player_pos.y + (NUM_OF_TILES_HEIGHT / 2.0f) >= static_cast<float>(map_size.y)) {y = static_cast<float>(map_size.y) - NUM_OF_TILES_HEIGHT;}
-    else {y = player_pos.y - NUM_OF_TILES_HEIGHT / 2.0f;}
+    InputState input;
 
+    // jump check
+    input.jump = glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS;
+    
+    // check horizontal movement
+    input.left = glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS;
+    input.right = glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS;
 
-    //          look at          camera pos             camera target          up vector
-    return glm::lookAt(glm::vec3(x, y, 1.0f), glm::vec3(x, y, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    return input;
 }
 
+
 /* EOF */
\ No newline at end of file
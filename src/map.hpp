@@ -1,4 +1,6 @@
-/// @brief a std::vector<std::vector<Tile*>> object wrapped into a class
+/// @brief a TileGrid read from a csv file (or its compiled copy), plus the chunks and instance buffer used to draw it.
+/// loading lives in map_loader.hpp so the grid can be used without any GL context.
+/// chunks are baked as they come on screen, and a few more each draw, so a large map never stalls one frame
 /// meant to make creating several maps per level for each layer of the map
 /// would not work on moving objects
 #ifndef MAP_CLASS
@@ -6,115 +8,266 @@
 
 #include <vector>
 #include <string>
-#include <fstream>
+#include <limits>
 #include <glm/glm.hpp>   // to use vec3 and mat4 needed to initialize tile 
-#include "tile.hpp"
+#include "tile_grid.hpp"
+#include "map_loader.hpp"
+#include "map_binary.hpp"
+#include "tile_palette.hpp"
+#include "tile_renderer.hpp"
+#include "tile_textures.hpp"
+#include "map_chunk.hpp"
+#include "shader_cache.hpp"
+#include "view_rect.hpp"
+#include "trace.hpp"
 
 class Map {
 public:
-    Map(std::string file_path,float tile_size, glm::mat4 perspective);
+    /// @brief how the map is submitted to the GPU
+    /// INSTANCED draws the visible tiles in one call,
+    /// CHUNKED draws one pre-baked mesh per MapChunk::SIZE x MapChunk::SIZE block of tiles
+    enum DrawMode {INSTANCED, CHUNKED};
+
+    /// @brief chunks baked per draw at most, besides the ones on screen
+    static const int BUILDS_PER_DRAW = 8;
+
+    /// @brief what the last draw submitted and skipped
+    /// counted in tiles for INSTANCED, and in chunks for CHUNKED.
+    /// culled only counts tiles of chunks baked so far
+    struct DrawStats {
+        int submitted = 0;
+        int culled = 0;
+    };
+
+    /// @param file_path csv map, loaded through its compiled copy when that is up to date (see load_map)
+    /// @param tile_size size of a tile in world space
+    /// @param verify_map hash every cell of the compiled map before using it
+    Map(std::string file_path,float tile_size, bool verify_map = false);
+
+    /// @brief build the map from a grid that was already loaded, eg by AssetLoader::read_map
+    /// @param grid the map tiles, moved into the map
+    /// @param tile_size size of a tile in world space
+    /// @param load_failed true if the grid came from a load that failed
+    Map(TileGrid&& grid, float tile_size, bool load_failed = false);
     ~Map();
 
-    void draw(glm::mat4 view);
+    /// @brief draw the part of the map overlapping the visible rect, using the camera set in the CameraBuffer
+    /// @param visible the tiles on screen (see visible_tiles), anything outside is culled
+    void draw(const ViewRect& visible);
+
+    /// @brief the tile images to draw with, must be set before the first draw and outlive the map
+    void set_textures(const TileTextures* tile_textures) {textures = tile_textures;}
+
+    /// @brief counts from the last call to draw
+    const DrawStats& draw_stats() const {return stats;}
 
-    /// @brief  member variables, data being displayed and if error in reading file
-    std::vector<std::vector<Tile*>> data;
+    /// @brief size of the map in tiles
+    int width() const {return grid.width();}
+    int height() const {return grid.height();}
+
+    /// @brief change a single cell of the map, rebuilding only what it touches
+    /// @param x column of the cell, 0 is the left edge
+    /// @param y row of the cell, 0 is the bottom edge
+    /// @param tile_id 0 for empty, otherwise the color index used in the csv, at most 255
+    void set_cell(int x, int y, int tile_id);
+
+    /// @brief  member variables, tile ids being displayed and if error in reading file
+    TileGrid grid;
     bool is_error;
 
+    DrawMode draw_mode = CHUNKED;
+
+private:
+    /// @brief copy the tiles inside the rect into the instance buffer of the renderer
+    void upload_instances(const ViewRect& visible);
+
+    /// @brief make the renderer for the loaded grid, the chunks are baked later by draw
+    void setup();
+
+    /// @brief bake the chunks overlapping the rect that are not baked yet, then up to BUILDS_PER_DRAW others
+    void bake_chunks(const ViewRect& rect);
+
+    /// @brief make and bake one chunk
+    void bake_chunk(int chunk_x, int chunk_y);
+
+    float tile_size;
+
+    int tile_count;     // number of solid tiles in the baked chunks
+
+    TileRenderer* renderer;
+    ViewRect uploaded_rect;     // tiles currently in the instance buffer
+    bool instances_dirty;       // a cell changed since the last upload
+
+    DrawStats stats;
+
+    std::vector<MapChunk*> chunks;      // chunks_wide * chunks_high, row major from the bottom left, nullptr until baked
+    int chunks_wide;
+    int chunks_high;
+    std::size_t next_unbaked;           // every chunk before this one is baked
+    std::shared_ptr<Shader> chunk_shader;
+    const TileTextures* textures;
 };
 
-Map::Map(std::string file_path, float tile_size, glm::mat4 perspective) {
+Map::Map(std::string file_path, float tile_size, bool verify_map)
+    : is_error(false), tile_size(tile_size), tile_count(0), textures(nullptr) {
+
+    // map the compiled copy of the csv, or read the csv straight into the grid if it is out of date
+    is_error = !load_map(file_path, grid, verify_map);
+    setup();
+}
+
+Map::Map(TileGrid&& grid, float tile_size, bool load_failed)
+    : grid(std::move(grid)), is_error(load_failed), tile_size(tile_size), tile_count(0), textures(nullptr) {
+    setup();
+}
+
+void Map::setup() {
+    // static tiles never move, so each chunk is only baked once.
+    // the instance buffer is filled with the visible tiles on the first draw
+    renderer = new TileRenderer(true);
+    uploaded_rect = ViewRect{0, 0, 0, 0};
+    instances_dirty = true;
 
-    // read the file into a temp int vector
-    std::vector<std::vector<int>> int_map;
+    chunk_shader = ShaderCache::instance().get("/home/miles/dev/platformer/src/tile_vertex.glsl","/home/miles/dev/platformer/src/tile_fragment.glsl", {"TEXTURED"});
 
-    std::ifstream file(file_path);
+    // round up so partial chunks on the top and right edges are kept
+    chunks_wide = (grid.width() + MapChunk::SIZE - 1) / MapChunk::SIZE;
+    chunks_high = (grid.height() + MapChunk::SIZE - 1) / MapChunk::SIZE;
+    chunks.assign(static_cast<std::size_t>(chunks_wide) * chunks_high, nullptr);
+    next_unbaked = 0;
+}
 
-    if (!file.is_open()) {
-        std::cerr << "Error opening file" << std::endl;
-        is_error = true;
+Map::~Map(){
+    delete renderer;
+    renderer = nullptr;
+
+    for (MapChunk*& chunk : chunks) {
+        delete chunk;
+        chunk = nullptr;
     }
-    else{
-        std::vector<int> row;
-        while (!file.eof()) {
-            char ch = file.peek();
-            switch (ch) {
-                case -1:   // ignore EOF character
-                case ' ':  // ignore spaces and commas
-                case ',':
-                    ch = file.get();
-                    break;
-
-                case '\n':  // push back the row onto the int map
-                    ch = file.get();
-                    int_map.push_back(row);
-                    row = std::vector<int>{};
-                    break;
-
-                
-                default:
-                    if (isdigit(ch)){
-                        int num;
-                        file >> num;
-                        row.push_back(num);
-                    }
-                    else {
-                        std::cerr << "unexpected char in csv @ " << file_path << ": " << ch << " or " << static_cast<int>(ch) << std::endl;
-                        is_error = true;
-                        ch = file.get();
-                    }
-                    break;
-
-            }   
+}
+
+void Map::draw(const ViewRect& visible) {
+    TRACE_SCOPE("Map::draw");
+
+    // only look at the part of the map that is on screen
+    ViewRect rect = visible.clamped(width(), height());
+    if (rect.min_x >= rect.max_x || rect.min_y >= rect.max_y) {rect = ViewRect{0, 0, 0, 0};}
+
+    // the chunks on screen have to be there this frame, the rest trickle in
+    bake_chunks(rect);
+
+    // every tile image is in the one array, bound once for the whole map
+    textures->bind();
+
+    if (draw_mode == INSTANCED) {
+        // refill the instance buffer only when the visible tiles change
+        if (rect != uploaded_rect || instances_dirty) {
+            upload_instances(rect);
         }
-        int_map.push_back(row);
+        renderer->draw();
+
+        stats.submitted = static_cast<int>(renderer->count());
+        stats.culled = tile_count - stats.submitted;
+        return;
     }
 
-    glm::vec3 color_map[] = {
-        glm::vec3(0.7f, 0.0f, 0.0f),    // red
-        glm::vec3(0.0f, 0.7f, 0.0f),    // green
-        glm::vec3(0.7f, 0.7f, 0.0f),    // yellow
-        glm::vec3(0.0f, 0.0f, 0.7f),    // blue
-        glm::vec3(0.7f, 0.0f, 0.7f),    // magenta
-        glm::vec3(0.0f, 0.7f, 0.7f),    // cyan
-    };
+    // CHUNKED
+    chunk_shader->use();
 
-    // turn the map into a 2d vector with nullptr for blank tiles, flipping it so 0,0 is bottom left
-    for (int y = 0; y < int_map.size(); ++y) {
-        std::vector<Tile*> new_vec;
-        for (int x = 0; x < int_map.at(0).size(); ++x){
-            if (int_map[y][x]) {
-                // push new tile to the row vector, invert the y position 
-                new_vec.push_back(new Tile(static_cast<float>(x) * tile_size, 
-                static_cast<float>(int_map.size() - y - 1) * tile_size, tile_size, tile_size, perspective,color_map[int_map[y][x] - 1]));
-            }
-            else {
-                new_vec.push_back(nullptr);
+    // chunk vertices are already in world space, so no offset and a unit scale
+    glVertexAttrib2f(1, 0.0f, 0.0f);
+    glVertexAttrib2f(2, 1.0f, 1.0f);
+
+    // walk only the chunks overlapping the rect, never the whole list
+    stats.submitted = 0;
+    if (rect.max_x > rect.min_x) {
+        int first_x = rect.min_x / MapChunk::SIZE;
+        int first_y = rect.min_y / MapChunk::SIZE;
+        int last_x = (rect.max_x - 1) / MapChunk::SIZE;
+        int last_y = (rect.max_y - 1) / MapChunk::SIZE;
+
+        for (int chunk_y = first_y; chunk_y <= last_y; ++chunk_y) {
+            for (int chunk_x = first_x; chunk_x <= last_x; ++chunk_x) {
+                chunks[chunk_y * chunks_wide + chunk_x]->draw();
+                ++stats.submitted;
             }
         }
-        data.insert(data.begin(), new_vec);
     }
+    stats.culled = static_cast<int>(chunks.size()) - stats.submitted;
+
+    glBindVertexArray(0);
+    glUseProgram(0);
 }
 
-Map::~Map(){
-    for (auto& row : data) {
-            for (Tile*& tile : row){
-                if (tile != nullptr){
-                    delete tile;
-                    tile = nullptr;
-                }
+void Map::set_cell(int x, int y, int tile_id) {
+    if (!grid.in_bounds(x, y)) {
+        std::cerr << "set_cell out of bounds: (" << x << ", " << y << ")" << std::endl;
+        return;
+    }
+    if (tile_id < 0 || tile_id > std::numeric_limits<TileGrid::TileId>::max()) {
+        std::cerr << "set_cell tile id out of range: " << tile_id << std::endl;
+        return;
+    }
+
+    grid.set(x, y, static_cast<TileGrid::TileId>(tile_id));
+
+    // only the chunk holding the cell needs to be baked again, one not baked yet reads the cell when it is
+    MapChunk* chunk = chunks.at((y / MapChunk::SIZE) * chunks_wide + (x / MapChunk::SIZE));
+    if (chunk) {
+        tile_count -= chunk->tile_count();
+        chunk->build(grid, tile_size);
+        tile_count += chunk->tile_count();
+    }
+
+    // the instance buffer is one block, it is rebuilt as a whole on the next draw
+    instances_dirty = true;
+}
+
+void Map::bake_chunks(const ViewRect& rect) {
+    if (next_unbaked == chunks.size()) {return;}   // all baked
+    TRACE_SCOPE("Map::bake_chunks");
+
+    if (rect.max_x > rect.min_x) {
+        for (int chunk_y = rect.min_y / MapChunk::SIZE; chunk_y <= (rect.max_y - 1) / MapChunk::SIZE; ++chunk_y) {
+            for (int chunk_x = rect.min_x / MapChunk::SIZE; chunk_x <= (rect.max_x - 1) / MapChunk::SIZE; ++chunk_x) {
+                if (!chunks[chunk_y * chunks_wide + chunk_x]) {bake_chunk(chunk_x, chunk_y);}
             }
         }
+    }
+
+    // then the rest in order, so a camera moving on finds its chunks ready
+    int baked = 0;
+    for (; next_unbaked < chunks.size() && baked < BUILDS_PER_DRAW; ++next_unbaked) {
+        if (chunks[next_unbaked]) {continue;}  // was on screen already
+        int index = static_cast<int>(next_unbaked);
+        bake_chunk(index % chunks_wide, index / chunks_wide);
+        ++baked;
+    }
+}
+
+void Map::bake_chunk(int chunk_x, int chunk_y) {
+    MapChunk* chunk = new MapChunk(chunk_x, chunk_y);
+    chunk->build(grid, tile_size);
+    chunks[chunk_y * chunks_wide + chunk_x] = chunk;
+    tile_count += chunk->tile_count();
 }
 
-void Map::draw(glm::mat4 view) {
-    for (auto& row : data) {
-            for (auto& tile : row){
-                if (tile != nullptr){
-                    tile->draw(view);
-                }
+void Map::upload_instances(const ViewRect& visible) {
+    std::vector<TileInstance> instances;
+    for (int y = visible.min_y; y < visible.max_y; ++y) {
+        for (int x = visible.min_x; x < visible.max_x; ++x) {
+            TileGrid::TileId id = grid.at(x, y);
+            if (id != 0){
+                glm::vec2 bottom_left = glm::vec2(static_cast<float>(x), static_cast<float>(y)) * tile_size;
+                instances.push_back(TileInstance{bottom_left, glm::vec2(tile_size, tile_size), tile_color(id), TileTextures::layer_of(id)});
             }
         }
+    }
+    renderer->upload(instances);
+
+    uploaded_rect = visible;
+    instances_dirty = false;
 }
 
 #endif 
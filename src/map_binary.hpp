@@ -0,0 +1,277 @@
+/// @brief Compiled maps: a TileGrid saved exactly as it sits in memory, so loading is a
+/// memory map of the file and a check of its header, with no parsing. The grid uses the
+/// mapped cells in place, so a map loads in the same time whatever its size.
+///
+/// Every csv map gets a compiled copy next to it (map.csv -> map.pmap). It is rebuilt from
+/// the csv whenever it is missing, corrupt, or older than the csv it was made from.
+///
+/// file layout, in the byte order of the machine that wrote it (a file from the other order is rebuilt):
+///     header  - MapFileHeader, 64 bytes
+///     cells   - TileGrid cells in block layout, TileGrid::storage_size(width, height) bytes
+#ifndef MAP_BINARY
+#define MAP_BINARY
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <memory>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <sys/stat.h>
+#include "tile_grid.hpp"
+#include "map_loader.hpp"
+#include "hash.hpp"
+#include "trace.hpp"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>        // MoveFileExA
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define MAP_BINARY_MMAP
+#endif
+
+const char MAP_FILE_MAGIC[4] = {'P', 'M', 'A', 'P'};
+const std::uint32_t MAP_FILE_VERSION = 1;
+const std::uint32_t MAP_FILE_BYTE_ORDER = 0x01020304;
+
+struct MapFileHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t block_bits;       // TileGrid::BLOCK_BITS the cells were laid out with
+    std::uint32_t byte_order;       // MAP_FILE_BYTE_ORDER as written by this machine
+    std::uint64_t source_size;      // size in bytes of the csv it was built from
+    std::int64_t source_time;       // modification time of the csv it was built from
+    std::uint64_t payload_size;     // bytes of cells after the header
+    std::uint64_t payload_hash;     // fnv1a of the cells
+    std::uint64_t header_hash;      // fnv1a of every field above this one
+};
+static_assert(sizeof(MapFileHeader) == 64, "MapFileHeader must stay 64 bytes, it is read straight from the file");
+
+/// @brief why a compiled map could or could not be used
+enum MapFileStatus {MAP_FILE_OK, MAP_FILE_MISSING, MAP_FILE_CORRUPT, MAP_FILE_STALE};
+
+/// @brief the size and modification time of a csv, used to tell when its compiled map is stale
+struct MapSource {
+    bool exists = false;
+    std::uint64_t size = 0;
+    std::int64_t time = 0;
+};
+
+/// @brief read the size and modification time of a file
+MapSource map_source_info(const std::string& csv_path) {
+    MapSource source;
+    struct stat info;
+    if (stat(csv_path.c_str(), &info) == 0) {
+        source.exists = true;
+        source.size = static_cast<std::uint64_t>(info.st_size);
+        source.time = static_cast<std::int64_t>(info.st_mtime);
+    }
+    return source;
+}
+
+/// @brief the compiled map kept next to a csv, map.csv -> map.pmap
+std::string compiled_map_path(const std::string& csv_path) {
+    const std::string extension = ".csv";
+    if (csv_path.size() >= extension.size() && csv_path.compare(csv_path.size() - extension.size(), extension.size(), extension) == 0) {
+        return csv_path.substr(0, csv_path.size() - extension.size()) + ".pmap";
+    }
+    return csv_path + ".pmap";
+}
+
+/// @brief true if the path names a compiled map rather than a csv
+bool is_compiled_map_path(const std::string& path) {
+    const std::string extension = ".pmap";
+    return path.size() >= extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+const char* map_file_status_name(MapFileStatus status) {
+    switch (status) {
+        case MAP_FILE_OK: return "ok";
+        case MAP_FILE_MISSING: return "missing";
+        case MAP_FILE_CORRUPT: return "corrupt";
+        case MAP_FILE_STALE: return "stale";
+    }
+    return "unknown";
+}
+
+/// @brief move a finished temporary file over another in one step, so a reader finds either the
+/// old file or the new one, never half of one or none at all. used by every writer of cached files
+/// @return false if it could not be moved, the temporary file is removed then
+bool replace_file(const std::string& temp_path, const std::string& path) {
+#ifdef _WIN32
+    // rename will not replace a file on windows, and removing the old one first leaves a gap
+    bool moved = MoveFileExA(temp_path.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    bool moved = std::rename(temp_path.c_str(), path.c_str()) == 0;
+#endif
+    if (!moved) {std::remove(temp_path.c_str());}
+    return moved;
+}
+
+/// @brief save a grid as a compiled map. written to a temporary file first and renamed
+/// over the old one, so a crash part way through never leaves a half written map
+/// @param source the csv the grid was loaded from, stored to detect when it changes
+/// @return false if the file could not be written
+bool write_map_binary(const std::string& path, const TileGrid& grid, const MapSource& source) {
+    MapFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAP_FILE_MAGIC, sizeof(header.magic));
+    header.version = MAP_FILE_VERSION;
+    header.width = static_cast<std::uint32_t>(grid.width());
+    header.height = static_cast<std::uint32_t>(grid.height());
+    header.block_bits = TileGrid::BLOCK_BITS;
+    header.byte_order = MAP_FILE_BYTE_ORDER;
+    header.source_size = source.size;
+    header.source_time = source.time;
+    header.payload_size = grid.memory_bytes();
+    header.payload_hash = fnv1a(grid.data(), grid.memory_bytes());
+    header.header_hash = fnv1a(&header, offsetof(MapFileHeader, header_hash));
+
+    std::string temp_path = path + ".tmp";
+    std::FILE* file = std::fopen(temp_path.c_str(), "wb");
+    if (file == nullptr) {
+        std::cerr << "could not write compiled map: " << path << std::endl;
+        return false;
+    }
+
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    if (header.payload_size > 0) {
+        ok = ok && std::fwrite(grid.data(), 1, header.payload_size, file) == header.payload_size;
+    }
+    ok = std::fclose(file) == 0 && ok;
+
+    if (!ok) {std::remove(temp_path.c_str());}
+    if (!ok || !replace_file(temp_path, path)) {
+        std::cerr << "could not write compiled map: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/// @brief map a whole file read only, kept alive by the returned pointer
+/// @param size [out] bytes in the file
+/// @return nullptr if the file could not be opened
+std::shared_ptr<const void> map_file(const std::string& path, std::size_t& size) {
+    size = 0;
+
+#ifdef MAP_BINARY_MMAP
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {return nullptr;}
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        close(fd);
+        return nullptr;
+    }
+    size = static_cast<std::size_t>(info.st_size);
+
+    void* base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // the mapping stays valid after the descriptor is closed
+    if (base == MAP_FAILED) {
+        size = 0;
+        return nullptr;
+    }
+
+    std::size_t length = size;
+    return std::shared_ptr<const void>(base, [length](const void* data) {munmap(const_cast<void*>(data), length);});
+#else
+    // no mmap, read the whole file into memory instead
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {return nullptr;}
+
+    std::shared_ptr<std::vector<char>> bytes = std::make_shared<std::vector<char>>(static_cast<std::size_t>(file.tellg()));
+    file.seekg(0);
+    if (bytes->empty() || !file.read(bytes->data(), static_cast<std::streamsize>(bytes->size()))) {return nullptr;}
+
+    size = bytes->size();
+    return std::shared_ptr<const void>(bytes, bytes->data());
+#endif
+}
+
+/// @brief load a compiled map, the grid views the mapped cells in place
+/// @param path the compiled map
+/// @param grid [out] set to view the map, left alone unless MAP_FILE_OK is returned
+/// @param source the csv the map should have been built from, nullptr to skip the stale check
+/// @param verify_payload also hash every cell, catches corrupt cells but takes time in the size of the map
+MapFileStatus load_map_binary(const std::string& path, TileGrid& grid, const MapSource* source, bool verify_payload = false) {
+    TRACE_SCOPE("load_map_binary");
+
+    std::size_t size = 0;
+    std::shared_ptr<const void> mapping = map_file(path, size);
+    if (!mapping) {return MAP_FILE_MISSING;}
+    if (size < sizeof(MapFileHeader)) {return MAP_FILE_CORRUPT;}
+
+    const unsigned char* base = static_cast<const unsigned char*>(mapping.get());
+    MapFileHeader header;
+    std::memcpy(&header, base, sizeof(header));
+
+    if (std::memcmp(header.magic, MAP_FILE_MAGIC, sizeof(header.magic)) != 0) {return MAP_FILE_CORRUPT;}
+    if (header.header_hash != fnv1a(&header, offsetof(MapFileHeader, header_hash))) {return MAP_FILE_CORRUPT;}
+
+    // an old version or a file from another machine is not corrupt, just needs rebuilding
+    if (header.version != MAP_FILE_VERSION || header.byte_order != MAP_FILE_BYTE_ORDER ||
+        header.block_bits != static_cast<std::uint32_t>(TileGrid::BLOCK_BITS)) {return MAP_FILE_STALE;}
+
+    if (header.width > 0x7fffffffu || header.height > 0x7fffffffu ||
+        header.payload_size != TileGrid::storage_size(static_cast<int>(header.width), static_cast<int>(header.height)) ||
+        size != sizeof(MapFileHeader) + header.payload_size) {return MAP_FILE_CORRUPT;}
+
+    if (source != nullptr && source->exists && (source->size != header.source_size || source->time != header.source_time)) {
+        return MAP_FILE_STALE;
+    }
+
+    const TileGrid::TileId* cells = reinterpret_cast<const TileGrid::TileId*>(base + sizeof(MapFileHeader));
+    if (verify_payload && fnv1a(cells, header.payload_size) != header.payload_hash) {return MAP_FILE_CORRUPT;}
+
+    grid.view_cells(static_cast<int>(header.width), static_cast<int>(header.height), cells, mapping);
+    return MAP_FILE_OK;
+}
+
+/// @brief load a map, using its compiled copy when it is up to date and rebuilding it from the csv when not
+/// @param path a csv map, or a compiled .pmap to load with no csv at all
+/// @param grid [out] the map
+/// @param verify_payload hash every cell of the compiled map before trusting it
+/// @return false if neither the compiled map nor the csv could be loaded
+bool load_map(const std::string& path, TileGrid& grid, bool verify_payload = false) {
+    if (is_compiled_map_path(path)) {
+        MapFileStatus status = load_map_binary(path, grid, nullptr, verify_payload);
+        if (status != MAP_FILE_OK) {
+            std::cerr << "compiled map " << path << " is " << map_file_status_name(status) << std::endl;
+        }
+        return status == MAP_FILE_OK;
+    }
+
+    std::string compiled = compiled_map_path(path);
+    MapSource source = map_source_info(path);
+
+    MapFileStatus status = load_map_binary(compiled, grid, &source, verify_payload);
+    if (status == MAP_FILE_OK) {return true;}
+
+    if (status != MAP_FILE_MISSING) {
+        std::cerr << "compiled map " << compiled << " is " << map_file_status_name(status) << ", rebuilding from " << path << std::endl;
+    }
+
+    if (!load_csv_map(path, grid)) {return false;}
+
+    // a failed write only costs the next launch a csv parse
+    write_map_binary(compiled, grid, source);
+    return true;
+}
+
+#endif
+/* EOF */
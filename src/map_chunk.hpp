@@ -0,0 +1,155 @@
+/// @brief A fixed-size square of map cells baked into one vertex/index buffer.
+/// Every solid tile in the chunk becomes a quad with its world position and texture
+/// layer built into the vertices, so the whole chunk draws with a single call.
+/// Editing a cell only needs the chunk holding it to be rebuilt
+#ifndef MAP_CHUNK_CLASS
+#define MAP_CHUNK_CLASS
+
+#include <glad/glad.h>
+#include <vector>
+#include <cstddef>                  // offsetof
+#include <glm/glm.hpp>
+#include "tile_grid.hpp"
+#include "tile_textures.hpp"
+
+/// @brief vertex layout baked into a chunk, position is already in world space
+struct ChunkVertex {
+    glm::vec3 pos;
+    glm::vec2 uv;       // corner of the tile image
+    float layer;        // layer in the TileTextures array
+};
+
+class MapChunk {
+public:
+    /// @brief width and height of a chunk in tiles
+    static const int SIZE = 32;
+
+    /// @param chunk_x column of the chunk, covers tiles [chunk_x * SIZE, (chunk_x + 1) * SIZE)
+    /// @param chunk_y row of the chunk, covers tiles [chunk_y * SIZE, (chunk_y + 1) * SIZE)
+    MapChunk(int chunk_x, int chunk_y);
+    ~MapChunk();
+
+    /// @brief bake every tile inside the chunk into the vertex and index buffers
+    /// @param grid the map tiles, with (0,0) at the bottom left
+    /// @param tile_size the size of a tile in world space
+    /// @param origin_x the tile the grid's column 0 sits at, for grids that hold only part of the map (eg a streamed region)
+    /// @param origin_y the tile the grid's row 0 sits at
+    void build(const TileGrid& grid, float tile_size, int origin_x = 0, int origin_y = 0);
+
+    /// @brief draw the chunk in one call.
+    /// the textured tile shader must already be in use, and the TileTextures bound (see Map::draw)
+    void draw() const;
+
+    /// @brief number of solid tiles baked into the chunk
+    int tile_count() const {return index_count / 6;}
+
+    /// @brief position of the chunk in the chunk grid
+    int x() const {return chunk_x;}
+    int y() const {return chunk_y;}
+
+private:
+    unsigned int EBO;
+    unsigned int VBO;
+    unsigned int VAO;
+
+    int index_count;
+
+    int chunk_x;
+    int chunk_y;
+};
+
+MapChunk::MapChunk(int chunk_x, int chunk_y) : chunk_x(chunk_x), chunk_y(chunk_y) {
+    index_count = 0;
+
+    VAO = 0;
+    VBO = 0;
+    EBO = 0;
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+
+    glBindVertexArray(VAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+    // position, layer and uv are per vertex, offset and size are left as constant
+    // attributes so tile_vertex.glsl passes the baked positions straight through
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ChunkVertex), reinterpret_cast<void*>(offsetof(ChunkVertex, pos)));
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(ChunkVertex), reinterpret_cast<void*>(offsetof(ChunkVertex, layer)));
+    glEnableVertexAttribArray(4);
+
+    glVertexAttribPointer(5, 2, GL_FLOAT, GL_FALSE, sizeof(ChunkVertex), reinterpret_cast<void*>(offsetof(ChunkVertex, uv)));
+    glEnableVertexAttribArray(5);
+
+    glBindVertexArray(0); // Unbind VAO for now
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+MapChunk::~MapChunk() {
+    // unnallocate opengl stuff
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    glDeleteVertexArrays(1, &VAO);
+}
+
+void MapChunk::build(const TileGrid& grid, float tile_size, int origin_x, int origin_y) {
+    std::vector<ChunkVertex> vertices;
+    std::vector<unsigned int> indeces;
+
+    // clamp the chunk to the edges of the grid
+    int y_end = (chunk_y + 1) * SIZE;
+    if (y_end > origin_y + grid.height()) {y_end = origin_y + grid.height();}
+    int x_end = (chunk_x + 1) * SIZE;
+    if (x_end > origin_x + grid.width()) {x_end = origin_x + grid.width();}
+
+    for (int y = chunk_y * SIZE; y < y_end; ++y) {
+        for (int x = chunk_x * SIZE; x < x_end; ++x) {
+            TileGrid::TileId id = grid.at(x - origin_x, y - origin_y);
+            if (id == 0) {continue;}
+
+            float left = static_cast<float>(x) * tile_size;
+            float bottom = static_cast<float>(y) * tile_size;
+            float layer = TileTextures::layer_of(id);
+
+            // same corner order as the unit quad in Tile
+            unsigned int first = static_cast<unsigned int>(vertices.size());
+            vertices.push_back(ChunkVertex{glm::vec3(left, bottom, 0.0f), glm::vec2(0.0f, 0.0f), layer});
+            vertices.push_back(ChunkVertex{glm::vec3(left, bottom + tile_size, 0.0f), glm::vec2(0.0f, 1.0f), layer});
+            vertices.push_back(ChunkVertex{glm::vec3(left + tile_size, bottom, 0.0f), glm::vec2(1.0f, 0.0f), layer});
+            vertices.push_back(ChunkVertex{glm::vec3(left + tile_size, bottom + tile_size, 0.0f), glm::vec2(1.0f, 1.0f), layer});
+
+            unsigned int quad[] = {0, 1, 2, 2, 3, 1};
+            for (unsigned int index : quad) {
+                indeces.push_back(first + index);
+            }
+        }
+    }
+
+    index_count = static_cast<int>(indeces.size());
+
+    // the element buffer binding is part of the VAO state, so bind the VAO first
+    glBindVertexArray(VAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(ChunkVertex), vertices.data(), GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indeces.size() * sizeof(unsigned int), indeces.data(), GL_STATIC_DRAW);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void MapChunk::draw() const {
+    if (index_count == 0) {return;}  // empty chunk
+
+    glBindVertexArray(VAO);
+    glDrawElements(GL_TRIANGLES, index_count, GL_UNSIGNED_INT, nullptr);
+}
+
+#endif
+/* EOF */
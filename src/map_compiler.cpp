@@ -0,0 +1,97 @@
+/// @brief Compiles csv maps ahead of time, so the game never has to parse them at launch.
+///
+///     platformer_mapc <map.csv> [out.pmap]
+///     platformer_mapc --world[=<region size>] <map.csv> [out.pworld]
+///
+/// the output defaults to the compiled path the game looks for (map.csv -> map.pmap).
+/// --world splits the map into regions for streaming instead (see StreamingWorld).
+/// The written map is read back and fully verified before the tool reports success
+#include <iostream>                         // push results to terminal
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include "tile_grid.hpp"                    // map tiles
+#include "map_loader.hpp"                   // read the csv
+#include "map_binary.hpp"                   // write and check the compiled map
+#include "world_file.hpp"                   // write and check streamed worlds
+
+/// @brief read every region of a world back and compare it with the grid it was made from
+bool verify_world(const std::string& path, const TileGrid& grid);
+
+int main(int argc, char** argv) {
+    std::vector<std::string> paths;
+    int region_size = 0;    // 0 for a single compiled map
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--world") {region_size = DEFAULT_REGION_SIZE;}
+        else if (arg.compare(0, 8, "--world=") == 0) {region_size = std::atoi(arg.c_str() + 8);}
+        else {paths.push_back(arg);}
+    }
+
+    if (paths.empty() || paths.size() > 2) {
+        std::cerr << "usage: " << argv[0] << " [--world[=<region size>]] <map.csv> [out]" << std::endl;
+        return 2;
+    }
+
+    std::string csv_path = paths[0];
+
+    TileGrid grid;
+    if (!load_csv_map(csv_path, grid)) {
+        std::cerr << "ERROR. MAP FAILED TO LOAD: " << csv_path << std::endl;
+        return 1;
+    }
+
+    if (region_size > 0) {
+        std::string out_path = paths.size() == 2 ? paths[1] : world_file_path(csv_path);
+        if (!write_world_file(out_path, grid, region_size) || !verify_world(out_path, grid)) {return 1;}
+
+        std::cout << csv_path << " -> " << out_path << " (" << grid.width() << " x " << grid.height() << ", "
+                  << region_size << " x " << region_size << " regions)" << std::endl;
+        return 0;
+    }
+
+    std::string out_path = paths.size() == 2 ? paths[1] : compiled_map_path(csv_path);
+    if (!write_map_binary(out_path, grid, map_source_info(csv_path))) {return 1;}
+
+    // read it back the way the game will, checking every cell
+    TileGrid check;
+    MapFileStatus status = load_map_binary(out_path, check, nullptr, true);
+    if (status != MAP_FILE_OK || check.width() != grid.width() || check.height() != grid.height()) {
+        std::cerr << "compiled map " << out_path << " did not read back: " << map_file_status_name(status) << std::endl;
+        return 1;
+    }
+
+    std::cout << csv_path << " -> " << out_path << " (" << grid.width() << " x " << grid.height() << ", "
+              << grid.solid_count() << " solid tiles, " << sizeof(MapFileHeader) + grid.memory_bytes() << " bytes)" << std::endl;
+    return 0;
+}
+
+bool verify_world(const std::string& path, const TileGrid& grid) {
+    WorldFile world;
+    if (!world.open(path) || world.width() != grid.width() || world.height() != grid.height()) {
+        std::cerr << "world " << path << " did not read back" << std::endl;
+        return false;
+    }
+
+    int size = world.region_size();
+    TileGrid region;
+    for (int index = 0; index < world.regions_wide() * world.regions_high(); ++index) {
+        int origin_x = (index % world.regions_wide()) * size;
+        int origin_y = (index / world.regions_wide()) * size;
+
+        bool same = world.read_region(index, region);
+        for (int y = 0; same && y < size && origin_y + y < grid.height(); ++y) {
+            for (int x = 0; same && x < size && origin_x + x < grid.width(); ++x) {
+                same = region.at(x, y) == grid.at(origin_x + x, origin_y + y);
+            }
+        }
+        if (!same) {
+            std::cerr << "world " << path << " region " << index << " did not read back" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+/* EOF */
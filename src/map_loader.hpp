@@ -0,0 +1,201 @@
+/// @brief Reads map files into a TileGrid. Needs no window or GL context,
+/// so the same loading code is used by the game and by the headless runner.
+///
+/// The csv is read in one go and parsed in two passes over the bytes: the first counts
+/// the rows and the width of the first row, the second writes every tile straight into
+/// the grid. With SSE2 both passes scan 16 bytes at a time, counting newlines and
+/// skipping runs of empty (0) tiles, which make up most of a level
+#ifndef MAP_LOADER
+#define MAP_LOADER
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstddef>
+#include <iostream>
+#include "tile_grid.hpp"
+#include "trace.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MAP_LOADER_SSE2
+#endif
+
+/// @brief read a csv map into the grid, flipping it so the last line of the file is row 0
+/// tiles are separated by commas or spaces, and every row must have as many tiles as the first
+/// @param file_path path to the csv file, one line per row of tiles
+/// @param grid [out] resized to the map and filled with its tile ids
+/// @return false if the file could not be opened or had errors, which are printed with their line and column
+bool load_csv_map(const std::string& file_path, TileGrid& grid);
+
+/// @brief read a whole file into memory
+/// @return false if the file could not be read
+bool read_whole_file(const std::string& file_path, std::vector<char>& bytes) {
+    std::FILE* file = std::fopen(file_path.c_str(), "rb");
+    if (file == nullptr) {return false;}
+
+    bytes.clear();
+    bool ok = std::fseek(file, 0, SEEK_END) == 0;
+    long size = ok ? std::ftell(file) : -1;
+    if (size > 0 && std::fseek(file, 0, SEEK_SET) == 0) {
+        bytes.resize(static_cast<std::size_t>(size));
+        ok = std::fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    }
+
+    std::fclose(file);
+    return ok && size >= 0;
+}
+
+/// @brief number of '\n' in a block of bytes
+std::size_t count_newlines(const char* data, std::size_t size) {
+    std::size_t count = 0;
+    std::size_t i = 0;
+
+#ifdef MAP_LOADER_SSE2
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; i + 16 <= size; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline)));
+        while (mask != 0) {
+            mask &= mask - 1;
+            ++count;
+        }
+    }
+#endif
+
+    for (; i < size; ++i) {
+        if (data[i] == '\n') {++count;}
+    }
+    return count;
+}
+
+/// @brief if the 16 bytes at data are only empty tiles and separators ("0,0,0,0,0,0,0,0,"),
+/// return how many tiles they hold. the last byte must be a separator, so no tile runs on past them
+/// @return -1 if the bytes hold anything else
+inline int count_empty_tiles(const char* data) {
+#ifdef MAP_LOADER_SSE2
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    unsigned int zeros = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('0'))));
+    unsigned int separators = static_cast<unsigned int>(_mm_movemask_epi8(_mm_or_si128(
+        _mm_cmpeq_epi8(bytes, _mm_set1_epi8(',')), _mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')))));
+
+    if ((zeros | separators) != 0xffffu || (separators & 0x8000u) == 0) {return -1;}
+
+    // a tile starts at every 0 that follows a separator (or the start, which follows one)
+    unsigned int starts = zeros & ~(zeros << 1);
+    int count = 0;
+    while (starts != 0) {
+        starts &= starts - 1;
+        ++count;
+    }
+    return count;
+#else
+    (void)data;
+    return -1;
+#endif
+}
+
+bool load_csv_map(const std::string& file_path, TileGrid& grid) {
+    TRACE_SCOPE("load_csv_map");
+
+    std::vector<char> bytes;
+    if (!read_whole_file(file_path, bytes)) {
+        std::cerr << "Error opening file: " << file_path << std::endl;
+        grid.resize(0, 0);
+        return false;
+    }
+
+    // drop blank lines (and separators) at the end of the file
+    std::size_t size = bytes.size();
+    while (size > 0 && (bytes[size - 1] == '\n' || bytes[size - 1] == '\r' || bytes[size - 1] == ' ' || bytes[size - 1] == ',')) {--size;}
+
+    const char* begin = bytes.data();
+    const char* end = begin + size;
+
+    // first pass, the number of rows and the width of the first one
+    int map_height = size == 0 ? 0 : static_cast<int>(count_newlines(begin, size)) + 1;
+    int map_width = 0;
+    bool in_tile = false;
+    for (const char* c = begin; c != end && *c != '\n'; ++c) {
+        bool digit = *c >= '0' && *c <= '9';
+        if (digit && !in_tile) {++map_width;}
+        in_tile = digit;
+    }
+
+    grid.resize(map_width, map_height);
+
+    // second pass, straight into the grid. the first line of the file is the top row
+    const int MAX_REPORTED = 10;
+    int errors = 0;
+    auto report = [&](int line, const char* at, const char* line_start, const std::string& message) {
+        if (errors < MAX_REPORTED) {
+            std::cerr << file_path << ":" << line << ":" << (at - line_start + 1) << ": " << message << std::endl;
+        }
+        ++errors;
+    };
+
+    int line = 1;
+    int x = 0;
+    int y = map_height - 1;
+    const char* line_start = begin;
+
+    auto end_row = [&](const char* at) {
+        if (x != map_width) {
+            report(line, at, line_start, "row has " + std::to_string(x) + " tiles, expected " + std::to_string(map_width));
+        }
+        ++line;
+        --y;
+        x = 0;
+    };
+
+    const char* c = begin;
+    while (c != end) {
+        // skip whole blocks of empty tiles at once, they are already 0 in the grid
+        if (end - c >= 16) {
+            int empty = count_empty_tiles(c);
+            if (empty >= 0 && x + empty <= map_width) {
+                x += empty;
+                c += 16;
+                continue;
+            }
+        }
+
+        char ch = *c;
+        if (ch >= '0' && ch <= '9') {
+            // read the whole tile id
+            const char* tile_start = c;
+            int value = 0;
+            while (c != end && *c >= '0' && *c <= '9') {
+                if (value <= 255) {value = value * 10 + (*c - '0');}    // stop growing once too large
+                ++c;
+            }
+
+            if (value > 255) {
+                report(line, tile_start, line_start, "tile id " + std::to_string(value) + " is larger than 255");
+            }
+            else if (value != 0 && x < map_width) {
+                grid.set(x, y, static_cast<TileGrid::TileId>(value));
+            }
+            ++x;
+            continue;
+        }
+
+        if (ch == '\n') {
+            end_row(c);
+            line_start = c + 1;
+        }
+        else if (ch != ',' && ch != ' ' && ch != '\r') {
+            report(line, c, line_start, std::string("unexpected character '") + ch + "' (" + std::to_string(static_cast<int>(ch)) + ")");
+        }
+        ++c;
+    }
+    if (size > 0) {end_row(end);}
+
+    if (errors > MAX_REPORTED) {
+        std::cerr << file_path << ": " << errors - MAX_REPORTED << " more errors" << std::endl;
+    }
+    return errors == 0;
+}
+
+#endif
+/* EOF */
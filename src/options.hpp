@@ -0,0 +1,129 @@
+/// @brief Command line options for the game, given as --name=value
+#ifndef OPTIONS_STRUCT
+#define OPTIONS_STRUCT
+
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include <cstdlib>
+
+struct Options {
+    float sim_rate = 60.0f;     // --sim-rate=<steps per second>
+    int max_steps = 5;          // --max-steps=<most sim steps per frame>
+    std::string map_path = "/home/miles/dev/platformer/resources/maps/map.csv";    // --map=<csv or compiled .pmap file>
+    bool verify_map = false;    // --verify-map hashes every cell of a compiled map before using it
+    std::string tile_sheet;     // --tiles=<binary .ppm sheet of 32x32 tile images> draws those on the map instead of the palette
+    std::string world_path;     // --world=<.pworld file> streams the level in around the player instead of loading a map
+    float world_budget_mb = 64.0f;  // --world-budget=<MB of region cells to keep loaded>
+    float world_radius = 48.0f; // --world-radius=<tiles around the player to load>
+    std::string shader_cache = "/home/miles/dev/platformer/shader_cache";   // --shader-cache=<folder> keeps linked shader programs, empty turns it off
+    int loader_threads = 0;     // --loader-threads=<asset loader workers>, 0 picks from the number of cores
+    bool upload_context = false;    // --upload-context uploads assets on a second, shared GL context
+    long long frames = 10000;   // --frames=<steps to run>, headless only
+    std::string record_path;    // --record=<file> writes every step's input to a recording
+    std::string replay_path;    // --replay=<file> plays a recording back instead of reading the keyboard
+    int physics_threads = 1;    // --physics-threads=<threads moving entities>, 1 keeps it on the main thread, 0 uses every core
+    std::string simd;           // --simd=<scalar|sse|avx2> the widest collision kernel to run, the CPU's best if not given
+    int actors = 0;             // --actors=<count> adds that many walkers to the level
+    int sprite_test = 0;        // --sprite-test=<count> draws that many extra moving sprites, to load the sprite batch
+    bool profile = false;       // --profile times every frame and shows the overlay
+    std::string profile_log;    // --profile-log=<file> also writes the frame times to a csv, implies --profile
+    std::string trace_path;     // --trace=<file> writes the cpu trace zones there at exit (F9 writes it any time)
+};
+
+/// @brief read the options out of the command line, unknown options are reported and ignored
+Options parse_options(int argc, char** argv) {
+    Options options;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        std::string name = arg;
+        std::string value;
+
+        std::size_t equals = arg.find('=');
+        if (equals != std::string::npos) {
+            name = arg.substr(0, equals);
+            value = arg.substr(equals + 1);
+        }
+
+        if (name == "--sim-rate") {
+            options.sim_rate = std::strtof(value.c_str(), nullptr);
+            if (options.sim_rate <= 0.0f) {
+                std::cerr << "invalid --sim-rate: " << value << ", using 60" << std::endl;
+                options.sim_rate = 60.0f;
+            }
+        }
+        else if (name == "--max-steps") {
+            options.max_steps = std::atoi(value.c_str());
+        }
+        else if (name == "--map") {
+            options.map_path = value;
+        }
+        else if (name == "--verify-map") {
+            options.verify_map = true;
+        }
+        else if (name == "--tiles") {
+            options.tile_sheet = value;
+        }
+        else if (name == "--world") {
+            options.world_path = value;
+        }
+        else if (name == "--world-budget") {
+            options.world_budget_mb = std::strtof(value.c_str(), nullptr);
+        }
+        else if (name == "--world-radius") {
+            options.world_radius = std::strtof(value.c_str(), nullptr);
+        }
+        else if (name == "--shader-cache") {
+            options.shader_cache = value;
+        }
+        else if (name == "--loader-threads") {
+            options.loader_threads = std::atoi(value.c_str());
+        }
+        else if (name == "--upload-context") {
+            options.upload_context = true;
+        }
+        else if (name == "--frames") {
+            options.frames = std::atoll(value.c_str());
+        }
+        else if (name == "--record") {
+            options.record_path = value;
+        }
+        else if (name == "--replay") {
+            options.replay_path = value;
+        }
+        else if (name == "--physics-threads") {
+            options.physics_threads = std::max(0, std::atoi(value.c_str()));
+        }
+        else if (name == "--simd") {
+            options.simd = value;
+        }
+        else if (name == "--actors") {
+            options.actors = std::max(0, std::atoi(value.c_str()));
+        }
+        else if (name == "--sprite-test") {
+            options.sprite_test = std::max(0, std::atoi(value.c_str()));
+        }
+        else if (name == "--profile") {
+            options.profile = true;
+        }
+        else if (name == "--profile-log") {
+            options.profile = true;
+            options.profile_log = value;
+        }
+        else if (name == "--trace") {
+            options.trace_path = value;
+#ifndef PLATFORMER_TRACE
+            std::cerr << "--trace needs a build with PLATFORMER_TRACE on, nothing will be written" << std::endl;
+#endif
+        }
+        else {
+            std::cerr << "unknown option: " << arg << std::endl;
+        }
+    }
+
+    return options;
+}
+
+#endif
+/* EOF */
@@ -1,140 +1,81 @@
+/// @brief the player, one entity in an EntityStore plus the input it takes.
+/// it moves with every other entity (see move_entities) and holds no GL objects,
+/// so it runs the same with or without a window (the game draws it with the SpriteBatch)
 #ifndef PLAYER_CLASS
 #define PLAYER_CLASS
 
-#include "tile.hpp"
-#include <vector>
-#include <GLFW/glfw3.h>
-#include <glad/glad.h>
+#include "aabb.hpp"
+#include "entity_store.hpp"
+#include "entity_systems.hpp"
+#include <cstdint>
 #include <glm/glm.hpp>
 
 class Player {
 public:
-    Player(glm::vec2 pos, glm::mat4 pojection);
-    ~Player();
+    /// @brief add the player to the store
+    /// @param entities where the player lives, must outlive it
+    /// @param pos bottom left corner of the player
+    Player(EntityStore& entities, glm::vec2 pos);
 
-    void draw(glm::mat4 view) {tile->draw(view);}
+    /// @brief removes the player entity again
+    ~Player() {entities.destroy(handle);}
 
-    /// @brief Move the player and collide with any hard tiles
-    /// @param collidable_surfaces all tiles that can be collided with
-    /// @param delta_time dt to normalize movement speed
-    void move(std::vector<Tile*> collidable_surfaces, float delta_time = 1.0f);
+    Player(const Player&) = delete;
+    Player& operator=(const Player&) = delete;
 
-    /// @brief returns the position of the center of the player
-    glm::vec2 pos() const {return tile->center();}
-
-    /// @brief update the player direction to move left or right
-    void move_right() {dir.x += 1.0f;}
-    void move_left() {dir.x -= 1.0f;}
-
-    /// @brief if possible, have the character jump
-    void jump();
-
-    // void set_view(glm::mat4 view) {tile->set_view_matrix(view);}
-    
+    /// @brief the player's entity
+    EntityHandle entity() const {return handle;}
 
-private:
-    glm::vec2 dir;
-    glm::vec2 size;
-    const glm::vec3 color{0.7, 0.4, 1.0};
-    const float speed = 2.0f;       // 2 tiles per second
-    Tile* tile;
-
-    bool can_jump;
-    bool jumped;
-    float time_airborn;
-
-
-};
-
-Player::Player(glm::vec2 pos, glm::mat4 projection) {
-    size = glm::vec2(0.5f, 0.75f);
-    dir = glm::vec2(0.0f, 0.0f);
-    tile = new Tile(pos.x, pos.y, size.x, size.y, projection, color);
-
-    can_jump = true;
-    jumped = false;
-    time_airborn = 0.0;
-}
-
-Player::~Player(){
-    delete tile;
-    tile = nullptr;
-}
-
-void Player::move(std::vector<Tile*> collidable_surfaces, float delta_time) {
-
-    // find how far to move x and y
-    float dx = dir.x * speed * delta_time;
-
-    const float OFFSET = 0.001f;  // small offset so not overlapping
-
-    // Horizontal collisions
-    tile->set_left(tile->left() + dx);
-    // loop through COLLidable TILEs
-    for (Tile*& coll_tile : collidable_surfaces){
-        if (colliding(*tile, *coll_tile)){
-            if (dir.x > 0.0f){ // moved right, stuck left
-                tile->set_right(coll_tile->left() - OFFSET);
-            } else if (dir.x < 0.0f){
-                tile->set_left(coll_tile->right() + OFFSET);
-                
-            }
-        }
+    /// @brief returns the position of the center of the player
+    glm::vec2 pos() const {
+        std::size_t i = index();
+        return (entities.box_min[i] + entities.box_max[i]) * 0.5f;
     }
 
-    // reset dir for next move frame
-    dir.x = 0.0f;
-
-    // using formula -32t + 10 (derivative of -16t&2 + 10t + h) to get per frame dy from 'gravity'
-    // if jumped, add vertical velocity, otherwise just falling
-    float dy = 0.0;
-    time_airborn += delta_time;
-    if (jumped){
-        dy = (-32 * time_airborn) + 14;
-    } else {
-        dy = (-32 * time_airborn);
+    /// @brief returns the center of the player blended between the previous and current step, for drawing
+    glm::vec2 interpolated_pos(float alpha) const {
+        std::size_t i = index();
+        return glm::mix((entities.previous_min[i] + entities.previous_max[i]) * 0.5f, pos(), alpha);
     }
 
-    dy *= 0.5f * delta_time;
+    /// @brief returns the bounds of the player
+    AABB bounds() const {return entities.bounds(index());}
 
-    // move the tile vertically
-    tile->set_bottom(tile->bottom() + dy);
-
-
-    for (Tile*& coll_tile : collidable_surfaces){
-        if (colliding(*tile, *coll_tile)){
+    /// @brief returns the bounds blended between the previous and current step, for drawing
+    /// @param alpha how far between the previous and current step to draw (see FixedTimestep::alpha)
+    AABB interpolated_bounds(float alpha) const {
+        std::size_t i = index();
+        return AABB{glm::mix(entities.previous_min[i], entities.box_min[i], alpha),
+                    glm::mix(entities.previous_max[i], entities.box_max[i], alpha)};
+    }
 
+    /// @brief fingerprint of everything that affects the next move, used to check replays stay deterministic
+    std::uint64_t state_hash() const {return entity_state_hash(entities, index());}
 
-            if (dy > 0.0f){ // moved up, stuck bottom
-                tile->set_top(coll_tile->bottom() - OFFSET);
+    /// @brief color to draw the player with
+    glm::vec3 draw_color() const {return entities.color[index()];}
 
-                // disable jumped, so no more upward velocity, reset time 
-                jumped = false;
-                time_airborn = 0.0f;
-            }
+    /// @brief update the player direction to move left or right
+    void move_right() {entities.dir_x[index()] += 1.0f;}
+    void move_left() {entities.dir_x[index()] -= 1.0f;}
 
+    /// @brief if possible, have the character jump
+    void jump() {entity_jump(entities, index());}
 
-            else if (dy < 0.0f){
-                // grounded, allow jumping again
-                can_jump = true;
-                jumped = false;
-                time_airborn = 0.0f;
+private:
+    std::size_t index() const {return entities.index_of(handle);}
 
-                tile->set_bottom(coll_tile->top());
-            }
-        }
-    }
+    EntityStore& entities;
+    EntityHandle handle;
+};
 
-    
-}
+Player::Player(EntityStore& entities, glm::vec2 pos) : entities(entities) {
+    const glm::vec2 size(0.5f, 0.75f);
+    const glm::vec3 color(0.7f, 0.4f, 1.0f);
+    const float speed = 2.0f;       // 2 tiles per second
 
-void Player::jump() {
-    if (!can_jump){return;}  // early return if no jump
-    
-    jumped = true;
-    //can_jump = false;
-    time_airborn = 0.0f;
+    handle = entities.create(pos, size, speed, color, EntityStore::CAN_JUMP);
 }
 
 #endif
-/* EOF */
\ No newline at end of file
+/* EOF */
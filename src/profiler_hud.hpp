@@ -0,0 +1,128 @@
+/// @brief Draws the FrameProfiler results over the game. The top left corner gets a graph of the
+/// recent CPU frame times, with a line at 16.7 ms (60 fps), and a bar to its right that stacks
+/// the GPU time of each pass. The numbers themselves go in the window title twice a second.
+/// Drawn with the tile shader through its own camera block, so the world camera is untouched
+#ifndef PROFILER_HUD_CLASS
+#define PROFILER_HUD_CLASS
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "frame_profiler.hpp"
+#include "tile_renderer.hpp"
+#include "camera.hpp"
+
+class ProfilerHud {
+public:
+    /// @brief frames shown in the graph
+    static const int GRAPH_FRAMES = 120;
+
+    /// @param title window title the numbers are added to
+    ProfilerHud(const std::string& title);
+    ~ProfilerHud();
+
+    /// @brief draw the overlay, this rebinds the camera block so call camera.bind() afterwards
+    void draw(const FrameProfiler& profiler);
+
+    /// @brief put the latest numbers in the window title, at most twice a second
+    void update_title(GLFWwindow* window, const FrameProfiler& profiler, double time);
+
+private:
+    TileRenderer renderer;
+    std::vector<TileInstance> bars;
+
+    unsigned int UBO;           // screen space camera, (0, 0) bottom left and (1, 1) top right
+    std::string title;
+    double last_title_time;
+};
+
+ProfilerHud::ProfilerHud(const std::string& title) : title(title), last_title_time(-1.0) {
+    CameraBlock block;
+    block.projection = glm::ortho(0.0f, 1.0f, 0.0f, 1.0f);
+    block.view = glm::mat4(1.0f);
+    block.view_projection = block.projection;
+
+    UBO = 0;
+    glGenBuffers(1, &UBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBlock), &block, GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    bars.reserve(GRAPH_FRAMES + FrameProfiler::PASS_COUNT + 2);
+}
+
+ProfilerHud::~ProfilerHud() {
+    glDeleteBuffers(1, &UBO);
+}
+
+void ProfilerHud::draw(const FrameProfiler& profiler) {
+    // graph area in screen space, a 33.3 ms frame fills the full height
+    const glm::vec2 corner = glm::vec2(0.01f, 0.80f);
+    const glm::vec2 graph_size = glm::vec2(0.25f, 0.18f);
+    const float full_ms = 33.3f;
+    const float bar_width = graph_size.x / GRAPH_FRAMES;
+
+    const glm::vec3 pass_colors[FrameProfiler::PASS_COUNT] = {
+        {0.4f, 0.4f, 0.9f}, {0.3f, 0.8f, 0.8f}, {0.7f, 0.4f, 1.0f}, {0.9f, 0.9f, 0.9f}
+    };
+
+    bars.clear();
+
+    // background
+    bars.push_back(TileInstance{corner, graph_size + glm::vec2(bar_width * 6.0f, 0.0f), glm::vec3(0.05f), 0.0f});
+
+    // cpu frame times, green under 60 fps, yellow under 30, red above
+    std::vector<double> times = profiler.history();
+    std::size_t first = times.size() > GRAPH_FRAMES ? times.size() - GRAPH_FRAMES : 0;
+    for (std::size_t i = first; i < times.size(); ++i) {
+        float ms = static_cast<float>(times[i]);
+        float height = glm::min(ms / full_ms, 1.0f) * graph_size.y;
+
+        glm::vec3 color = ms < 16.7f ? glm::vec3(0.2f, 0.8f, 0.2f) : (ms < 33.3f ? glm::vec3(0.9f, 0.8f, 0.2f) : glm::vec3(0.9f, 0.2f, 0.2f));
+        bars.push_back(TileInstance{corner + glm::vec2(static_cast<float>(i - first) * bar_width, 0.0f), glm::vec2(bar_width, height), color, 0.0f});
+    }
+
+    // 60 fps line
+    bars.push_back(TileInstance{corner + glm::vec2(0.0f, graph_size.y * 16.7f / full_ms), glm::vec2(graph_size.x, 0.002f), glm::vec3(1.0f), 0.0f});
+
+    // gpu passes stacked to the right of the graph
+    const FrameProfiler::FrameStats& latest = profiler.latest();
+    float stacked = 0.0f;
+    for (int pass = 0; pass < FrameProfiler::PASS_COUNT; ++pass) {
+        float height = static_cast<float>(latest.gpu_ms[pass]) / full_ms * graph_size.y;
+        height = glm::min(height, graph_size.y - stacked);
+        if (height <= 0.0f) {continue;}
+
+        bars.push_back(TileInstance{corner + glm::vec2(graph_size.x + bar_width * 2.0f, stacked),
+                                    glm::vec2(bar_width * 3.0f, height), pass_colors[pass], 0.0f});
+        stacked += height;
+    }
+
+    renderer.upload(bars);
+
+    glBindBufferBase(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, UBO);
+    renderer.draw();
+}
+
+void ProfilerHud::update_title(GLFWwindow* window, const FrameProfiler& profiler, double time) {
+    if (time - last_title_time < 0.5) {return;}
+    last_title_time = time;
+
+    const FrameProfiler::FrameStats& latest = profiler.latest();
+
+    char text[256];
+    int length = std::snprintf(text, sizeof(text), "%s | cpu %.2f ms p50 %.2f p95 %.2f p99 %.2f | gpu",
+                               title.c_str(), latest.cpu_ms, profiler.percentile(50.0), profiler.percentile(95.0), profiler.percentile(99.0));
+    for (int pass = 0; pass < FrameProfiler::PASS_COUNT && length > 0 && length < static_cast<int>(sizeof(text)); ++pass) {
+        length += std::snprintf(text + length, sizeof(text) - length, " %s %.2f", FrameProfiler::pass_name(pass), latest.gpu_ms[pass]);
+    }
+
+    glfwSetWindowTitle(window, text);
+}
+
+#endif
+/* EOF */
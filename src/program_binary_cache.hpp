@@ -0,0 +1,267 @@
+/// @brief Keeps linked shader programs on disk so later runs can skip compiling them.
+/// Each program is saved with glGetProgramBinary under a name made from its source and the
+/// driver (vendor, renderer and version), and handed back to glProgramBinary next time. A
+/// binary the driver rejects, eg after a driver update, is deleted and the program compiled as normal.
+///
+/// program binaries are core only from OpenGL 4.1 (or with ARB_get_program_binary), which the
+/// 3.3 glad loader does not know about, so the three functions needed are looked up here.
+/// Without them the cache simply stays off.
+///
+/// file layout, one file per program named <key in hex>.glbin:
+///     header  - ProgramBinaryHeader, 32 bytes
+///     binary  - what glGetProgramBinary returned, in the driver's own format
+#ifndef PROGRAM_BINARY_CACHE_CLASS
+#define PROGRAM_BINARY_CACHE_CLASS
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <sys/stat.h>
+#include "hash.hpp"
+#include "map_binary.hpp"     // replace_file
+#include "trace.hpp"
+
+#ifdef _WIN32
+#include <direct.h>     // _mkdir
+#endif
+
+// from OpenGL 4.1, missing from the 3.3 headers
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+const char PROGRAM_BINARY_MAGIC[4] = {'P', 'B', 'I', 'N'};
+const std::uint32_t PROGRAM_BINARY_VERSION = 1;
+
+struct ProgramBinaryHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t format;           // binary format the driver gave back
+    std::uint32_t length;           // bytes of binary after the header
+    std::uint64_t key;              // fnv1a of the driver strings and both sources, also the file name
+    std::uint64_t binary_hash;      // fnv1a of the binary
+};
+static_assert(sizeof(ProgramBinaryHeader) == 32, "ProgramBinaryHeader must stay 32 bytes, it is read straight from the file");
+
+class ProgramBinaryCache {
+public:
+    /// @brief the single cache shared by every Shader
+    static ProgramBinaryCache& instance();
+
+    /// @brief the folder binaries are kept in, made on the first save. empty turns the cache off
+    void set_directory(const std::string& path) {directory = path;}
+
+    /// @brief true if the cache is on and the driver can save program binaries.
+    /// worked out the first time it is called, a context must be current
+    bool enabled();
+
+    /// @brief fill a new program from its saved binary
+    /// @param program a program with nothing attached yet
+    /// @return true if the program is linked and ready, false if it still has to be compiled
+    bool load(unsigned int program, const char* vertexCode, const char* fragmentCode);
+
+    /// @brief ask the driver to keep the binary of a program around, call before linking it
+    void prepare(unsigned int program);
+
+    /// @brief save the binary of a program that just linked
+    void store(unsigned int program, const char* vertexCode, const char* fragmentCode);
+
+    /// @brief programs loaded from disk, compiled because nothing was saved, and saved binaries the driver refused
+    int hit_count() const {return hits;}
+    int miss_count() const {return misses;}
+    int rejected_count() const {return rejected;}
+
+private:
+    typedef void (APIENTRY* GetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+    typedef void (APIENTRY* ProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+    typedef void (APIENTRY* ProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+
+    ProgramBinaryCache();
+
+    /// @brief look up the functions and hash the driver strings
+    void probe();
+
+    /// @brief the key of a program, its sources on the driver that will run it
+    std::uint64_t key_of(const char* vertexCode, const char* fragmentCode) const;
+
+    std::string file_path(std::uint64_t key) const;
+
+    std::string directory;
+    bool probed;
+    bool supported;
+    std::uint64_t driver_hash;
+
+    GetProgramBinaryProc get_program_binary;
+    ProgramBinaryProc program_binary;
+    ProgramParameteriProc program_parameteri;
+
+    int hits;
+    int misses;
+    int rejected;
+};
+
+ProgramBinaryCache& ProgramBinaryCache::instance() {
+    static ProgramBinaryCache cache;
+    return cache;
+}
+
+ProgramBinaryCache::ProgramBinaryCache()
+    : probed(false), supported(false), driver_hash(FNV_OFFSET_BASIS), get_program_binary(nullptr),
+      program_binary(nullptr), program_parameteri(nullptr), hits(0), misses(0), rejected(0) {}
+
+bool ProgramBinaryCache::enabled() {
+    if (directory.empty()) {return false;}
+    if (!probed) {probe();}
+    return supported;
+}
+
+void ProgramBinaryCache::probe() {
+    probed = true;
+
+    get_program_binary = reinterpret_cast<GetProgramBinaryProc>(glfwGetProcAddress("glGetProgramBinary"));
+    program_binary = reinterpret_cast<ProgramBinaryProc>(glfwGetProcAddress("glProgramBinary"));
+    program_parameteri = reinterpret_cast<ProgramParameteriProc>(glfwGetProcAddress("glProgramParameteri"));
+    if (!get_program_binary || !program_binary || !program_parameteri) {return;}
+
+    // some drivers have the functions but no formats to save in
+    int formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    while (glGetError() != GL_NO_ERROR) {}
+    if (formats <= 0) {return;}
+
+    // a binary is only good on the exact driver that made it
+    GLenum names[] = {GL_VENDOR, GL_RENDERER, GL_VERSION};
+    for (GLenum name : names) {
+        const char* value = reinterpret_cast<const char*>(glGetString(name));
+        if (value == nullptr) {return;}
+        driver_hash = fnv1a(value, std::strlen(value) + 1, driver_hash);
+    }
+
+    supported = true;
+}
+
+std::uint64_t ProgramBinaryCache::key_of(const char* vertexCode, const char* fragmentCode) const {
+    std::uint64_t key = fnv1a(vertexCode, std::strlen(vertexCode) + 1, driver_hash);
+    key = fnv1a(fragmentCode, std::strlen(fragmentCode) + 1, key);
+    return fnv1a_value(PROGRAM_BINARY_VERSION, key);
+}
+
+std::string ProgramBinaryCache::file_path(std::uint64_t key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.glbin", static_cast<unsigned long long>(key));
+    return directory + "/" + name;
+}
+
+bool ProgramBinaryCache::load(unsigned int program, const char* vertexCode, const char* fragmentCode) {
+    if (!enabled()) {return false;}
+    TRACE_SCOPE("ProgramBinaryCache::load");
+
+    std::uint64_t key = key_of(vertexCode, fragmentCode);
+    std::string path = file_path(key);
+
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        ++misses;
+        return false;
+    }
+
+    ProgramBinaryHeader header;
+    std::vector<char> binary;
+    bool ok = std::fread(&header, sizeof(header), 1, file) == 1 &&
+              std::memcmp(header.magic, PROGRAM_BINARY_MAGIC, sizeof(header.magic)) == 0 &&
+              header.version == PROGRAM_BINARY_VERSION && header.key == key && header.length > 0;
+    if (ok) {
+        binary.resize(header.length);
+        ok = std::fread(binary.data(), 1, binary.size(), file) == binary.size() &&
+             fnv1a(binary.data(), binary.size()) == header.binary_hash;
+    }
+    std::fclose(file);
+
+    if (ok) {
+        program_binary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+
+        int linked = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        ok = linked != 0;
+    }
+
+    if (!ok) {
+        // the program is left unlinked, so the caller can still compile and link it as normal
+        std::cerr << "shader binary " << path << " was rejected, compiling instead" << std::endl;
+        std::remove(path.c_str());
+        ++rejected;
+        return false;
+    }
+
+    ++hits;
+    return true;
+}
+
+void ProgramBinaryCache::prepare(unsigned int program) {
+    if (!enabled()) {return;}
+    program_parameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+void ProgramBinaryCache::store(unsigned int program, const char* vertexCode, const char* fragmentCode) {
+    if (!enabled()) {return;}
+    TRACE_SCOPE("ProgramBinaryCache::store");
+
+    int length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {return;}
+
+    std::vector<char> binary(static_cast<std::size_t>(length));
+    GLenum format = 0;
+    GLsizei written = 0;
+    get_program_binary(program, length, &written, &format, binary.data());
+    if (written <= 0) {return;}
+    binary.resize(static_cast<std::size_t>(written));
+
+    ProgramBinaryHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, PROGRAM_BINARY_MAGIC, sizeof(header.magic));
+    header.version = PROGRAM_BINARY_VERSION;
+    header.format = static_cast<std::uint32_t>(format);
+    header.length = static_cast<std::uint32_t>(binary.size());
+    header.key = key_of(vertexCode, fragmentCode);
+    header.binary_hash = fnv1a(binary.data(), binary.size());
+
+    // fails harmlessly if the folder is already there
+#ifdef _WIN32
+    _mkdir(directory.c_str());
+#else
+    mkdir(directory.c_str(), 0755);
+#endif
+
+    // written beside the real name and moved over it, so a reader never sees half a file
+    std::string path = file_path(header.key);
+    std::string temp_path = path + ".tmp";
+    std::FILE* file = std::fopen(temp_path.c_str(), "wb");
+    if (file == nullptr) {
+        std::cerr << "could not save shader binary: " << path << std::endl;
+        return;
+    }
+
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+              std::fwrite(binary.data(), 1, binary.size(), file) == binary.size();
+    ok = std::fclose(file) == 0 && ok;
+
+    if (!ok) {std::remove(temp_path.c_str());}
+    if (!ok || !replace_file(temp_path, path)) {
+        std::cerr << "could not save shader binary: " << path << std::endl;
+    }
+}
+
+#endif
+/* EOF */
@@ -0,0 +1,221 @@
+/// @brief Records the input of every simulation step to a compact binary file, and plays it back.
+/// Each step stores the keys held (one byte) and a 32 bit hash of the player state after the step,
+/// so a replay can check every step lands on exactly the same state as the recording.
+///
+/// file layout, all little endian:
+///     header  - "PRPL" magic, uint32 version, float seconds per step
+///     steps   - uint8 input bits (jump = 1, left = 2, right = 4), uint32 state hash
+#ifndef REPLAY_CLASSES
+#define REPLAY_CLASSES
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <iostream>
+#include "input.hpp"
+
+const char REPLAY_MAGIC[4] = {'P', 'R', 'P', 'L'};
+const std::uint32_t REPLAY_VERSION = 1;
+
+/// @brief pack the keys into the input bits stored per step
+std::uint8_t pack_input(const InputState& input) {
+    return static_cast<std::uint8_t>((input.jump ? 1 : 0) | (input.left ? 2 : 0) | (input.right ? 4 : 0));
+}
+
+/// @brief unpack the input bits stored per step
+InputState unpack_input(std::uint8_t bits) {
+    InputState input;
+    input.jump = (bits & 1) != 0;
+    input.left = (bits & 2) != 0;
+    input.right = (bits & 4) != 0;
+    return input;
+}
+
+/// @brief fold a 64 bit state hash down to the 32 bits stored per step
+std::uint32_t fold_hash(std::uint64_t hash) {
+    return static_cast<std::uint32_t>(hash ^ (hash >> 32));
+}
+
+class InputRecorder {
+public:
+    InputRecorder() : file(nullptr), steps(0) {}
+    ~InputRecorder() {close();}
+
+    /// @brief start a new recording, replacing any file already at the path
+    /// @param path where to write the recording
+    /// @param step_time seconds simulated per step, replays must use the same
+    /// @return false if the file could not be created
+    bool open(const std::string& path, float step_time);
+
+    /// @brief add one simulation step, call after the step has been simulated
+    /// @param input the keys applied this step
+    /// @param state_hash Player::state_hash() after the step
+    void record(const InputState& input, std::uint64_t state_hash);
+
+    /// @brief finish the file
+    void close();
+
+    bool is_open() const {return file != nullptr;}
+    long long step_count() const {return steps;}
+
+private:
+    std::FILE* file;
+    long long steps;
+};
+
+class InputReplay {
+public:
+    InputReplay() : file(nullptr), step_time(0.0f), steps(0), mismatches(0), first_mismatch(-1), expected(0) {}
+    ~InputReplay() {close();}
+
+    /// @brief open a recording made by InputRecorder
+    /// @return false if the file is missing or is not a recording
+    bool open(const std::string& path);
+
+    /// @brief read the input for the next step
+    /// @param input [out] the keys held on this step
+    /// @return false once the recording has run out
+    bool next(InputState& input);
+
+    /// @brief compare the state after the step with the recording, call after every next()
+    /// @param state_hash Player::state_hash() after the step
+    /// @return true if the step matched
+    bool verify(std::uint64_t state_hash);
+
+    void close();
+
+    bool is_open() const {return file != nullptr;}
+
+    /// @brief seconds simulated per step when this was recorded
+    float step() const {return step_time;}
+
+    long long step_count() const {return steps;}
+    long long mismatch_count() const {return mismatches;}
+
+    /// @brief the step the replay first went off the recording, -1 if it never did
+    long long first_mismatch_step() const {return first_mismatch;}
+
+private:
+    std::FILE* file;
+    float step_time;
+    long long steps;
+    long long mismatches;
+    long long first_mismatch;
+    std::uint32_t expected;     // hash recorded for the current step
+};
+
+/* write and read little endian values one byte at a time, so files work on any machine */
+
+void write_u32(std::FILE* file, std::uint32_t value) {
+    unsigned char bytes[4] = {
+        static_cast<unsigned char>(value), static_cast<unsigned char>(value >> 8),
+        static_cast<unsigned char>(value >> 16), static_cast<unsigned char>(value >> 24)
+    };
+    std::fwrite(bytes, 1, 4, file);
+}
+
+bool read_u32(std::FILE* file, std::uint32_t& value) {
+    unsigned char bytes[4];
+    if (std::fread(bytes, 1, 4, file) != 4) {return false;}
+    value = static_cast<std::uint32_t>(bytes[0]) | (static_cast<std::uint32_t>(bytes[1]) << 8) |
+            (static_cast<std::uint32_t>(bytes[2]) << 16) | (static_cast<std::uint32_t>(bytes[3]) << 24);
+    return true;
+}
+
+bool InputRecorder::open(const std::string& path, float step_time) {
+    close();
+
+    file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        std::cerr << "could not create recording: " << path << std::endl;
+        return false;
+    }
+
+    std::uint32_t step_bits;
+    std::memcpy(&step_bits, &step_time, sizeof(step_bits));
+
+    std::fwrite(REPLAY_MAGIC, 1, sizeof(REPLAY_MAGIC), file);
+    write_u32(file, REPLAY_VERSION);
+    write_u32(file, step_bits);
+
+    steps = 0;
+    return true;
+}
+
+void InputRecorder::record(const InputState& input, std::uint64_t state_hash) {
+    if (file == nullptr) {return;}
+
+    std::fputc(pack_input(input), file);
+    write_u32(file, fold_hash(state_hash));
+    ++steps;
+}
+
+void InputRecorder::close() {
+    if (file == nullptr) {return;}
+    std::fclose(file);
+    file = nullptr;
+}
+
+bool InputReplay::open(const std::string& path) {
+    close();
+
+    file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        std::cerr << "could not open recording: " << path << std::endl;
+        return false;
+    }
+
+    char magic[4];
+    std::uint32_t version = 0;
+    std::uint32_t step_bits = 0;
+    if (std::fread(magic, 1, sizeof(magic), file) != sizeof(magic) || std::memcmp(magic, REPLAY_MAGIC, sizeof(magic)) != 0 ||
+        !read_u32(file, version) || !read_u32(file, step_bits)) {
+        std::cerr << "not a recording: " << path << std::endl;
+        close();
+        return false;
+    }
+    if (version != REPLAY_VERSION) {
+        std::cerr << "recording " << path << " is version " << version << ", expected " << REPLAY_VERSION << std::endl;
+        close();
+        return false;
+    }
+
+    std::memcpy(&step_time, &step_bits, sizeof(step_time));
+    steps = 0;
+    mismatches = 0;
+    first_mismatch = -1;
+    return true;
+}
+
+bool InputReplay::next(InputState& input) {
+    if (file == nullptr) {return false;}
+
+    int bits = std::fgetc(file);
+    if (bits == EOF || !read_u32(file, expected)) {return false;}
+
+    input = unpack_input(static_cast<std::uint8_t>(bits));
+    ++steps;
+    return true;
+}
+
+bool InputReplay::verify(std::uint64_t state_hash) {
+    if (fold_hash(state_hash) == expected) {return true;}
+
+    // only report the first step that went wrong, everything after it will differ too
+    if (first_mismatch == -1) {
+        first_mismatch = steps - 1;
+        std::cerr << "replay diverged from the recording at step " << first_mismatch << std::endl;
+    }
+    ++mismatches;
+    return false;
+}
+
+void InputReplay::close() {
+    if (file == nullptr) {return;}
+    std::fclose(file);
+    file = nullptr;
+}
+
+#endif
+/* EOF */
@@ -6,6 +6,10 @@
 /// @date 5/31/24 - First version created
 /// @date 6/4/24 - added StatusEnum to track if an invalid shader is made
 /// also added a default constructor to better work with object classes
+/// @date 10/16/26 - active uniforms are looked up once after linking, and
+/// typed Uniform handles let the draw loop skip glGetUniformLocation entirely
+/// @date 10/16/26 - linked programs are saved by ProgramBinaryCache, so later
+/// runs load them instead of compiling
 
 #ifndef SHADER_H
 #define SHADER_H
@@ -16,10 +20,28 @@
 #include <fstream>
 #include <sstream> 
 #include <iostream>
+#include <unordered_map>
+#include <unordered_set>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#include "trace.hpp"
+#include "program_binary_cache.hpp"
+
+/// @brief fixed binding points for uniform blocks shared between programs.
+/// any program with a block of the matching name is linked to it automatically
+enum UniformBlockBinding {CAMERA_BLOCK_BINDING = 0};
+
+/// @brief a uniform location resolved ahead of time by Shader::uniform().
+/// the type picks which glUniform function Shader::set() uses, so a mat4
+/// handle can never be fed a float by mistake
+template <typename T>
+struct Uniform {
+    int location = -1;    // -1 is ignored by every glUniform call
+
+    bool valid() const {return location != -1;}
+};
 
 class Shader
 {
@@ -46,6 +68,20 @@ private:
     /// @param fragmentCode  - the c-string containing the entire fragment shader code
     void compile_shaders(const char* vertexCode, const char* fragmentCode);
 
+    /// @brief store the location of every active uniform in the linked program
+    /// so nothing has to ask the driver for them later
+    void cache_uniforms();
+
+    /// @brief link any shared uniform blocks (eg Camera) to their fixed binding point
+    void bind_uniform_blocks();
+
+    /// @brief return the cached location of a uniform, or -1 if it does not exist.
+    /// a missing name is only printed the first time it is asked for
+    int find_uniform(const std::string &name) const;
+
+    std::unordered_map<std::string, int> uniforms;              // uniform name -> location
+    mutable std::unordered_set<std::string> reported_missing;   // names already warned about
+
 public:
     enum ConstructorType {USING_FILE_PATHS, USING_SHADER_STRING};
     
@@ -63,33 +99,54 @@ public:
     // give read-only ID
     unsigned int get_ID() const {return ID;}
 
+    /// @brief get a typed handle to a uniform, resolve these once and keep them
+    /// @param name the name of the uniform in the shader code
+    template <typename T>
+    Uniform<T> uniform(const std::string &name) const
+    {
+        Uniform<T> handle;
+        handle.location = find_uniform(name);
+        return handle;
+    }
+
+    // set a uniform through a pre-resolved handle, no string or location lookup
+    // the program must already be in use
+    void set(Uniform<bool> handle, bool value) const {glUniform1i(handle.location, static_cast<int>(value));}
+    void set(Uniform<int> handle, int value) const {glUniform1i(handle.location, value);}
+    void set(Uniform<float> handle, float value) const {glUniform1f(handle.location, value);}
+    void set(Uniform<glm::vec2> handle, glm::vec2 value) const {glUniform2f(handle.location, value.x, value.y);}
+    void set(Uniform<glm::vec3> handle, glm::vec3 value) const {glUniform3f(handle.location, value.x, value.y, value.z);}
+    void set(Uniform<glm::mat4> handle, const glm::mat4 &value) const 
+    {
+        glUniformMatrix4fv(handle.location, 1, GL_FALSE, glm::value_ptr(value));
+    }
+
     // utility uniform functions
-    // same as calling FUNCTION(glGetUniformLocation(shader, "uniform_name"),...)
-    // for all glUniform functions
+    // same as calling FUNCTION(location, ...) for all glUniform functions,
+    // with the location taken from the cache built when the program was linked
     void setBool(const std::string &name, bool value) const
     {
         if (status == INVALID_SHADERS) {return;}  // return if in invalid state
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), 
-                                  static_cast<int>(value));
+        glUniform1i(find_uniform(name), static_cast<int>(value));
     }
     void setInt(const std::string &name, int value) const
     {
         if (status == INVALID_SHADERS) {return;}  // return if in invalid state
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1i(find_uniform(name), value);
     }
     void setFloat(const std::string &name, float value) const
     {
         if (status == INVALID_SHADERS) {return;}  // return if in invalid state
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1f(find_uniform(name), value);
     }
     void setMat4(const std::string &name, glm::mat4 value) const
     {
         if (status == INVALID_SHADERS) {return;}  // return if in invalid state
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+        glUniformMatrix4fv(find_uniform(name), 1, GL_FALSE, glm::value_ptr(value));
     }
     void setVec3(const std::string &name, glm::vec3 &value){
         if (status == INVALID_SHADERS) {return;}  // return if in invalid state
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), value.x, value.y, value.z);
+        glUniform3f(find_uniform(name), value.x, value.y, value.z);
     }
 };
 
@@ -170,8 +227,21 @@ void Shader::read_files(const char* vertexPath, const char* fragmentPath,
 
 void Shader::compile_shaders(const char* vertexCode, const char* fragmentCode)
 {
+    TRACE_SCOPE("Shader::compile_shaders");
+
     if (status == INVALID_SHADERS) {return;}  // return if in invalid state
 
+    // shader program
+    ID = glCreateProgram();  // sets the private-member variable ID
+
+    // a program linked on an earlier run needs no compiling at all
+    ProgramBinaryCache& binaries = ProgramBinaryCache::instance();
+    if (binaries.load(ID, vertexCode, fragmentCode)) {
+        cache_uniforms();
+        bind_uniform_blocks();
+        return;
+    }
+
     unsigned int vertex, fragment;   // opengl ID for shaders
     int success;                     // flag compile error
     char infoLog[512];               // log to display compiler messages
@@ -204,10 +274,9 @@ void Shader::compile_shaders(const char* vertexCode, const char* fragmentCode)
         status = INVALID_SHADERS;
     }
 
-    // shader program
-    ID = glCreateProgram();  // sets the private-member variable ID
     glAttachShader(ID, vertex);
     glAttachShader(ID, fragment);
+    binaries.prepare(ID);
     glLinkProgram(ID);
     // print any linking errors
     glGetProgramiv(ID, GL_LINK_STATUS, &success);
@@ -222,6 +291,64 @@ void Shader::compile_shaders(const char* vertexCode, const char* fragmentCode)
     // delete the shaders cuz their linked, so we can free the memory
     glDeleteShader(vertex);
     glDeleteShader(fragment);
+
+    if (status == VALID_SHADERS) {
+        binaries.store(ID, vertexCode, fragmentCode);
+        cache_uniforms();
+        bind_uniform_blocks();
+    }
+}
+
+void Shader::bind_uniform_blocks()
+{
+    unsigned int camera_index = glGetUniformBlockIndex(ID, "Camera");
+    if (camera_index != GL_INVALID_INDEX) {
+        glUniformBlockBinding(ID, camera_index, CAMERA_BLOCK_BINDING);
+    }
+}
+
+void Shader::cache_uniforms()
+{
+    uniforms.clear();
+
+    int count = 0;           // number of active uniforms
+    int max_length = 0;      // longest uniform name, including the null terminator
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+
+    std::string name_buffer(static_cast<std::size_t>(max_length) + 1, '\0');
+    for (int i = 0; i < count; ++i)
+    {
+        int length = 0;
+        int size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(ID, static_cast<GLuint>(i), max_length + 1, &length, &size, &type, &name_buffer[0]);
+        std::string name(name_buffer.c_str(), static_cast<std::size_t>(length));
+
+        // uniforms inside a block have no location of their own
+        int location = glGetUniformLocation(ID, name.c_str());
+        if (location == -1) {continue;}
+
+        // arrays are reported as "name[0]", allow them to be found as just "name"
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+            uniforms[name.substr(0, name.size() - 3)] = location;
+        }
+        uniforms[name] = location;
+    }
+}
+
+int Shader::find_uniform(const std::string &name) const
+{
+    auto found = uniforms.find(name);
+    if (found != uniforms.end()) {return found->second;}
+
+    // only complain once, this can be called every frame
+    if (status == VALID_SHADERS && reported_missing.insert(name).second)
+    {
+        std::cout << "WARNING::SHADER::UNIFORM_NOT_FOUND: " << name
+                  << " (not declared, or unused and optimized out)" << std::endl;
+    }
+    return -1;
 }
 
 #endif  // closing include guard
@@ -0,0 +1,156 @@
+/// @brief A process-wide cache of linked shader programs. Programs are keyed by
+/// their full source code plus any #defines injected into them, so every tile
+/// asking for the same shader shares one reference-counted program instead of
+/// reading, compiling and linking its own copy. Shader files are only read
+/// from disk the first time their path is asked for, or not at all if they were
+/// read ahead of time and given to add_file
+#ifndef SHADER_CACHE_CLASS
+#define SHADER_CACHE_CLASS
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <unordered_map>
+#include "shader.hpp"
+
+class ShaderCache {
+public:
+    /// @brief the single cache shared by the whole program
+    static ShaderCache& instance();
+
+    /// @brief get a program built from two shader files, compiling it only if no one else is using it
+    /// @param vertexPath - the file path to the vertex shader
+    /// @param fragmentPath - the file path to the fragment shader
+    /// @param defines - names to #define at the top of both shaders, eg {"TEXTURED"}
+    /// @return shared program, deleted once the last user lets go of it
+    std::shared_ptr<Shader> get(const std::string& vertexPath, const std::string& fragmentPath,
+                                const std::vector<std::string>& defines = {});
+
+    /// @brief same as get(), but given the shader source code directly
+    std::shared_ptr<Shader> get_from_source(const std::string& vertexCode, const std::string& fragmentCode,
+                                            const std::vector<std::string>& defines = {});
+
+    /// @brief hand the cache a file that was read elsewhere (eg by AssetLoader), so get() never reads it from disk.
+    /// a file the cache already holds is kept as it is
+    void add_file(const std::string& path, std::string&& contents) {files.emplace(path, std::move(contents));}
+
+    /// @brief number of programs currently alive in the cache
+    std::size_t program_count() const;
+
+    /// @brief forget every cached file, programs already handed out stay valid
+    void clear() {files.clear(); programs.clear();}
+
+private:
+    ShaderCache() = default;
+
+    /// @brief return the contents of a file, reading it from disk only the first time.
+    /// a file that could not be read comes back empty and is tried again next time
+    const std::string& read_file(const std::string& path);
+
+    /// @brief insert a #define line for every define right after the #version line
+    static std::string apply_defines(const std::string& code, const std::vector<std::string>& defines);
+
+    std::unordered_map<std::string, std::string> files;                   // file path -> contents
+    std::unordered_map<std::string, std::weak_ptr<Shader>> programs;      // defines + sources -> program
+};
+
+ShaderCache& ShaderCache::instance() {
+    static ShaderCache cache;
+    return cache;
+}
+
+std::shared_ptr<Shader> ShaderCache::get(const std::string& vertexPath, const std::string& fragmentPath,
+                                         const std::vector<std::string>& defines) {
+    return get_from_source(read_file(vertexPath), read_file(fragmentPath), defines);
+}
+
+std::shared_ptr<Shader> ShaderCache::get_from_source(const std::string& vertexCode, const std::string& fragmentCode,
+                                                     const std::vector<std::string>& defines) {
+    // build the key, the defines are kept in front so two define sets never collide
+    std::string key;
+    for (const std::string& define : defines) {
+        key += define;
+        key += '\n';
+    }
+    key += '\0';
+    key += vertexCode;
+    key += '\0';
+    key += fragmentCode;
+
+    // drop programs every user has let go of, so the keys (whole sources) do not pile up
+    for (auto entry = programs.begin(); entry != programs.end();) {
+        if (entry->second.expired() && entry->first != key) {entry = programs.erase(entry);}
+        else {++entry;}
+    }
+
+    // reuse the program if someone is still holding onto it
+    std::weak_ptr<Shader>& cached = programs[key];
+    std::shared_ptr<Shader> program = cached.lock();
+    if (program) {return program;}
+
+    // otherwise compile it once and remember it
+    std::string vertex = apply_defines(vertexCode, defines);
+    std::string fragment = apply_defines(fragmentCode, defines);
+    program = std::make_shared<Shader>(vertex.c_str(), fragment.c_str(), Shader::USING_SHADER_STRING);
+    cached = program;
+
+    return program;
+}
+
+std::size_t ShaderCache::program_count() const {
+    std::size_t count = 0;
+    for (const auto& entry : programs) {
+        if (!entry.second.expired()) {++count;}
+    }
+    return count;
+}
+
+const std::string& ShaderCache::read_file(const std::string& path) {
+    auto found = files.find(path);
+    if (found != files.end()) {return found->second;}
+
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ\n\t"
+                  << path << std::endl;
+        static const std::string NO_CODE;
+        return NO_CODE;
+    }
+
+    std::stringstream stream;
+    stream << file.rdbuf();
+
+    std::string& code = files[path];
+    code = stream.str();
+    return code;
+}
+
+std::string ShaderCache::apply_defines(const std::string& code, const std::vector<std::string>& defines) {
+    if (defines.empty()) {return code;}
+
+    std::string define_lines;
+    for (const std::string& define : defines) {
+        define_lines += "#define " + define + "\n";
+    }
+
+    // #version has to stay the first line of the shader
+    std::size_t insert_at = 0;
+    if (code.compare(0, 8, "#version") == 0) {
+        std::size_t line_end = code.find('\n');
+        insert_at = (line_end == std::string::npos) ? code.size() : line_end + 1;
+    }
+
+    std::string result = code;
+    if (insert_at == result.size() && (result.empty() || result.back() != '\n')) {
+        result += '\n';
+        insert_at = result.size();
+    }
+    result.insert(insert_at, define_lines);
+    return result;
+}
+
+#endif
+/* EOF */
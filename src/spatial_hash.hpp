@@ -0,0 +1,316 @@
+/// @brief Broadphase for entity versus entity collision: a uniform grid laid over the map, each
+/// cell listing the entities whose boxes reach into it. Only entities sharing a cell can touch,
+/// so finding the pairs to test costs about the number of entities instead of its square.
+///
+/// the grid is rebuilt from the store every step with a counting sort, two straight passes over
+/// the boxes and no allocation once it has grown to fit. Everything comes out in index order, so
+/// the pairs are the same on every run and every machine.
+///
+/// the boxes of a crowded cell are packed once and the narrowphase tests each against the rest of
+/// the cell with overlap_mask. Most cells hold only a few entities, those are tested pair by pair
+#ifndef SPATIAL_HASH_CLASS
+#define SPATIAL_HASH_CLASS
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+#include "aabb.hpp"
+#include "aabb_overlap.hpp"
+#include "entity_store.hpp"
+#include "trace.hpp"
+#include "worker_pool.hpp"
+
+class SpatialHash {
+public:
+    /// @brief two entity indices that share a cell, first < second
+    typedef std::pair<std::uint32_t, std::uint32_t> Pair;
+
+    /// @brief lay the cells over a map of tiles
+    /// @param map_width width of the map in tiles
+    /// @param map_height height of the map in tiles
+    /// @param tile_size the size of a tile in world space
+    /// @param tiles_per_cell width and height of a cell in tiles, best a little larger than most entities
+    SpatialHash(int map_width, int map_height, float tile_size, int tiles_per_cell = 2);
+
+    /// @brief sort every entity of the store into the cells it overlaps.
+    /// the store must not change until the next rebuild, queries read its boxes
+    void rebuild(const EntityStore& entities);
+
+    /// @brief every pair of entities sharing at least one cell, each reported once.
+    /// they may still not overlap, test them with colliding() (see overlapping_pairs)
+    /// @param pairs [out] cleared, then filled
+    void candidate_pairs(std::vector<Pair>& pairs) const;
+
+    /// @brief the candidate pairs whose boxes do overlap
+    /// @param pairs [out] cleared, then filled
+    void overlapping_pairs(std::vector<Pair>& pairs) const;
+
+    /// @brief overlapping_pairs, with bands of cell rows searched on the threads of a pool.
+    /// each band fills its own list and the lists are joined in row order afterwards,
+    /// so the pairs come out exactly as from the single threaded search
+    void overlapping_pairs(WorkerPool& pool, std::vector<Pair>& pairs) const;
+
+    /// @brief every entity whose box overlaps an area (colliding(area, box)), in index order
+    /// @param found [out] cleared, then filled with entity indices
+    void query_rect(const AABB& area, std::vector<std::uint32_t>& found) const;
+
+    /// @brief every entity whose box contains a point, in index order
+    /// @param found [out] cleared, then filled with entity indices
+    void query_point(glm::vec2 point, std::vector<std::uint32_t>& found) const;
+
+    /// @brief (columns, rows) of cells
+    glm::ivec2 cell_count() const {return cells;}
+
+    /// @brief width and height of a cell in world space
+    float cell_size() const {return size;}
+
+private:
+    /// @brief cell a point falls in, clamped so entities off the map land in the border cells
+    glm::ivec2 cell_of(glm::vec2 point) const;
+
+    /// @brief add the pairs reported by a range of cell rows, see candidate_pairs
+    /// @param overlapping only add pairs whose boxes overlap
+    void pairs_in_rows(int first_row, int end_row, bool overlapping, std::vector<Pair>& pairs) const;
+
+    /// @brief pack the boxes of a cell's entities, in entry order
+    void pack_cell(int cell, AABBBatch& boxes) const;
+
+    /// @brief index into cell_start of a cell
+    int cell_index(glm::ivec2 cell) const {return cell.y * cells.x + cell.x;}
+
+    glm::ivec2 cells;
+    float size;
+
+    const EntityStore* store;
+
+    std::vector<std::uint32_t> cell_start;  // per cell, where its entities start in entries, plus one past the end
+    std::vector<std::uint32_t> entries;     // entity indices, grouped by cell
+    std::vector<glm::ivec2> first_cell;     // per entity, the lowest cell its box reaches
+    std::vector<glm::ivec2> last_cell;      // per entity, the highest
+
+    mutable std::vector<std::vector<Pair>> band_pairs;    // per band of rows, for the threaded search
+
+    mutable AABBBatch query_boxes;              // a crowded cell packed for query_rect
+    mutable std::vector<std::uint32_t> seen;    // per entity, the query that last found it
+    mutable std::uint32_t query_stamp;
+};
+
+SpatialHash::SpatialHash(int map_width, int map_height, float tile_size, int tiles_per_cell) : store(nullptr), query_stamp(0) {
+    if (tiles_per_cell < 1) {tiles_per_cell = 1;}
+
+    size = tile_size * static_cast<float>(tiles_per_cell);
+    cells.x = std::max(1, (map_width + tiles_per_cell - 1) / tiles_per_cell);
+    cells.y = std::max(1, (map_height + tiles_per_cell - 1) / tiles_per_cell);
+
+    cell_start.assign(static_cast<std::size_t>(cells.x) * cells.y + 1, 0);
+}
+
+glm::ivec2 SpatialHash::cell_of(glm::vec2 point) const {
+    int x = static_cast<int>(std::floor(point.x / size));
+    int y = static_cast<int>(std::floor(point.y / size));
+    return glm::ivec2(std::min(std::max(x, 0), cells.x - 1), std::min(std::max(y, 0), cells.y - 1));
+}
+
+void SpatialHash::rebuild(const EntityStore& entities) {
+    TRACE_SCOPE("SpatialHash::rebuild");
+
+    store = &entities;
+    std::size_t count = entities.size();
+    first_cell.resize(count);
+    last_cell.resize(count);
+    if (seen.size() < count) {seen.resize(count, 0);}
+
+    // count the entities of every cell, offset by one so the prefix sum leaves the starts behind
+    std::fill(cell_start.begin(), cell_start.end(), 0);
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        glm::ivec2 first = cell_of(entities.box_min[i]);
+        glm::ivec2 last = cell_of(entities.box_max[i]);
+        first_cell[i] = first;
+        last_cell[i] = last;
+
+        for (int y = first.y; y <= last.y; ++y) {
+            for (int x = first.x; x <= last.x; ++x) {
+                ++cell_start[cell_index(glm::ivec2(x, y)) + 1];
+            }
+        }
+        total += static_cast<std::size_t>(last.x - first.x + 1) * (last.y - first.y + 1);
+    }
+
+    for (std::size_t cell = 1; cell < cell_start.size(); ++cell) {
+        cell_start[cell] += cell_start[cell - 1];
+    }
+
+    // then drop every entity into its cells, counting each cell's start back up as it fills
+    entries.resize(total);
+    for (std::size_t i = 0; i < count; ++i) {
+        for (int y = first_cell[i].y; y <= last_cell[i].y; ++y) {
+            for (int x = first_cell[i].x; x <= last_cell[i].x; ++x) {
+                entries[cell_start[cell_index(glm::ivec2(x, y))]++] = static_cast<std::uint32_t>(i);
+            }
+        }
+    }
+
+    // each start now sits where the next cell begins, shift them back
+    for (std::size_t cell = cell_start.size() - 1; cell > 0; --cell) {
+        cell_start[cell] = cell_start[cell - 1];
+    }
+    cell_start[0] = 0;
+}
+
+void SpatialHash::candidate_pairs(std::vector<Pair>& pairs) const {
+    TRACE_SCOPE("SpatialHash::candidate_pairs");
+
+    pairs.clear();
+    pairs_in_rows(0, cells.y, false, pairs);
+}
+
+void SpatialHash::overlapping_pairs(std::vector<Pair>& pairs) const {
+    TRACE_SCOPE("SpatialHash::overlapping_pairs");
+
+    pairs.clear();
+    pairs_in_rows(0, cells.y, true, pairs);
+}
+
+void SpatialHash::overlapping_pairs(WorkerPool& pool, std::vector<Pair>& pairs) const {
+    TRACE_SCOPE("SpatialHash::overlapping_pairs");
+
+    pairs.clear();
+
+    // a few bands per thread, crowds bunch up in some rows and leave others empty
+    int bands = std::min(pool.thread_count() * 4, cells.y);
+    if (bands <= 1 || entries.size() < 1024) {
+        pairs_in_rows(0, cells.y, true, pairs);
+        return;
+    }
+
+    if (static_cast<int>(band_pairs.size()) < bands) {band_pairs.resize(bands);}
+    pool.run(bands, [this, bands](int band) {
+        std::vector<Pair>& found = band_pairs[band];
+        found.clear();
+        pairs_in_rows(cells.y * band / bands, cells.y * (band + 1) / bands, true, found);
+    });
+
+    // merge in row order, the same order the single threaded search finds them in
+    std::size_t total = 0;
+    for (int band = 0; band < bands; ++band) {total += band_pairs[band].size();}
+    pairs.reserve(total);
+    for (int band = 0; band < bands; ++band) {
+        pairs.insert(pairs.end(), band_pairs[band].begin(), band_pairs[band].end());
+    }
+}
+
+void SpatialHash::pack_cell(int cell, AABBBatch& boxes) const {
+    boxes.clear();
+    for (std::uint32_t at = cell_start[cell]; at < cell_start[cell + 1]; ++at) {
+        boxes.add(store->bounds(entries[at]));
+    }
+}
+
+void SpatialHash::pairs_in_rows(int first_row, int end_row, bool overlapping, std::vector<Pair>& pairs) const {
+    // most cells hold a handful of entities, packing those costs more than the kernel saves
+    const std::uint32_t PACK_FROM = 32;
+    AABBBatch cell_boxes;
+
+    for (int y = first_row; y < end_row; ++y) {
+        for (int x = 0; x < cells.x; ++x) {
+            int cell = cell_index(glm::ivec2(x, y));
+            std::uint32_t begin = cell_start[cell];
+            std::uint32_t end = cell_start[cell + 1];
+
+            bool packed = overlapping && end - begin >= PACK_FROM;
+            if (packed) {pack_cell(cell, cell_boxes);}
+
+            for (std::uint32_t a = begin; a < end; ++a) {
+                std::uint32_t first = entries[a];
+                AABB first_box = store->bounds(first);
+
+                // boxes spanning several cells meet in each of them, report the pair only in the lowest one they share
+                auto lowest_shared = [&](std::uint32_t second) {
+                    return std::max(first_cell[first].x, first_cell[second].x) == x &&
+                           std::max(first_cell[first].y, first_cell[second].y) == y;
+                };
+
+                if (!packed) {
+                    for (std::uint32_t b = a + 1; b < end; ++b) {
+                        std::uint32_t second = entries[b];
+                        if (!lowest_shared(second)) {continue;}
+                        if (overlapping && !colliding(first_box, store->bounds(second))) {continue;}
+
+                        pairs.push_back(Pair(first, second));
+                    }
+                    continue;
+                }
+
+                // a crowded cell, test the rest of it a word at a time
+                for (std::uint32_t word_start = a + 1; word_start < end; word_start += 64) {
+                    std::uint32_t word_count = std::min<std::uint32_t>(64, end - word_start);
+                    std::uint64_t hits;
+                    overlap_mask(first_box, cell_boxes.arrays().from(word_start - begin), word_count, &hits);
+
+                    for (; hits; hits &= hits - 1) {
+                        std::uint32_t second = entries[word_start + lowest_bit(hits)];
+                        if (lowest_shared(second)) {pairs.push_back(Pair(first, second));}
+                    }
+                }
+            }
+        }
+    }
+}
+
+void SpatialHash::query_rect(const AABB& area, std::vector<std::uint32_t>& found) const {
+    found.clear();
+    if (store == nullptr) {return;}
+
+    // stamp each entity as it is found, so one spanning several cells is reported once
+    ++query_stamp;
+    if (query_stamp == 0) {
+        std::fill(seen.begin(), seen.end(), 0);
+        query_stamp = 1;
+    }
+
+    glm::ivec2 first = cell_of(area.min);
+    glm::ivec2 last = cell_of(area.max);
+    for (int y = first.y; y <= last.y; ++y) {
+        for (int x = first.x; x <= last.x; ++x) {
+            int cell = cell_index(glm::ivec2(x, y));
+            std::uint32_t begin = cell_start[cell];
+
+            pack_cell(cell, query_boxes);
+            for (std::uint32_t word_start = 0; word_start < query_boxes.size(); word_start += 64) {
+                std::uint32_t word_count = std::min<std::uint32_t>(64, static_cast<std::uint32_t>(query_boxes.size()) - word_start);
+                std::uint64_t hits;
+                overlap_mask(area, query_boxes.arrays().from(word_start), word_count, &hits);
+
+                for (; hits; hits &= hits - 1) {
+                    std::uint32_t i = entries[begin + word_start + lowest_bit(hits)];
+                    if (seen[i] == query_stamp) {continue;}
+                    seen[i] = query_stamp;
+                    found.push_back(i);
+                }
+            }
+        }
+    }
+    std::sort(found.begin(), found.end());
+}
+
+void SpatialHash::query_point(glm::vec2 point, std::vector<std::uint32_t>& found) const {
+    found.clear();
+    if (store == nullptr) {return;}
+
+    // a point is in a single cell, nothing there can be listed twice
+    int cell = cell_index(cell_of(point));
+    for (std::uint32_t at = cell_start[cell]; at < cell_start[cell + 1]; ++at) {
+        std::uint32_t i = entries[at];
+        AABB box = store->bounds(i);
+        if (point.x >= box.left() && point.x < box.right() && point.y >= box.bottom() && point.y < box.top()) {
+            found.push_back(i);
+        }
+    }
+}
+
+#endif
+/* EOF */
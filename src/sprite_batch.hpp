@@ -0,0 +1,217 @@
+/// @brief Draws every moving quad of a frame (the player, and later enemies, projectiles and
+/// pickups) with one instanced draw call. Sprites are collected in a plain array as the frame
+/// goes, then copied into a vertex buffer the GPU reads them from.
+///
+/// the buffer is a ring of SECTIONS parts, and each draw writes the next part. Each part is mapped
+/// unsynchronized, so the driver never stalls to check whether the GPU still reads it. A fence
+/// placed after each draw guards that instead. The CPU only waits when it laps the GPU, which
+/// takes SECTIONS frames in flight
+#ifndef SPRITE_BATCH_CLASS
+#define SPRITE_BATCH_CLASS
+
+#include <glad/glad.h>
+#include <cstddef>                  // offsetof
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+#include "shader.hpp"
+#include "shader_cache.hpp"
+#include "tile_renderer.hpp"        // TileInstance, the same per-instance layout
+#include "trace.hpp"
+
+class SpriteBatch {
+public:
+    /// @brief parts of the ring, draws the GPU may be behind by before the CPU waits
+    static const int SECTIONS = 3;
+
+    /// @param capacity sprites per draw before the buffer has to grow
+    /// @param textured draw the sprites with their TileTextures layer instead of their color,
+    /// the array must be bound to texture unit 0 when drawing (see TileTextures::bind)
+    explicit SpriteBatch(std::size_t capacity = 1024, bool textured = false);
+    ~SpriteBatch();
+
+    SpriteBatch(const SpriteBatch&) = delete;
+    SpriteBatch& operator=(const SpriteBatch&) = delete;
+
+    /// @brief queue a sprite for the next draw
+    void add(const TileInstance& sprite) {sprites.push_back(sprite);}
+
+    /// @brief queue a colored quad for the next draw
+    /// @param bottom_left corner of the quad in world space
+    /// @param size (width, height) of the quad
+    void add(glm::vec2 bottom_left, glm::vec2 size, glm::vec3 color) {sprites.push_back(TileInstance{bottom_left, size, color, 0.0f});}
+
+    /// @brief stream the queued sprites to the GPU and draw them in one call, using the camera set in the CameraBuffer.
+    /// the queue is empty afterwards
+    void draw();
+
+    /// @brief sprites waiting for the next draw
+    std::size_t count() const {return sprites.size();}
+
+    /// @brief sprites the ring holds per draw, grows to fit the largest draw
+    std::size_t capacity() const {return section_capacity;}
+
+    /// @brief draws that had to wait for the GPU to finish with a part of the ring
+    int stall_count() const {return stalls;}
+
+private:
+    /// @brief (re)make the ring buffer with room for this many sprites per section
+    void allocate(std::size_t capacity);
+
+    /// @brief wait until the GPU is done with a section, if it is not already
+    void wait_for(int section);
+
+    unsigned int EBO;
+    unsigned int VBO;           // the unit quad
+    unsigned int VAO;
+    unsigned int ring_VBO;      // SECTIONS * section_capacity sprites
+
+    std::size_t section_capacity;
+    int section;                // the section the next draw writes
+    GLsync fences[SECTIONS];    // set after a section's draw, until the GPU has read it
+    int stalls;
+
+    std::vector<TileInstance> sprites;
+
+    std::shared_ptr<Shader> shader;   // shared with every other user of the same program
+};
+
+SpriteBatch::SpriteBatch(std::size_t capacity, bool textured) : section_capacity(0), section(0), stalls(0) {
+    for (GLsync& fence : fences) {fence = nullptr;}
+
+    VAO = 0;
+    VBO = 0;
+    EBO = 0;
+    ring_VBO = 0;
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &ring_VBO);
+
+    glBindVertexArray(VAO);
+
+    // the same unit quad TileRenderer draws from
+    create_unit_quad(VBO, EBO);
+
+    // per-instance attributes, pointed at the section being drawn in draw()
+    for (unsigned int attribute = 1; attribute <= 4; ++attribute) {
+        glEnableVertexAttribArray(attribute);
+        glVertexAttribDivisor(attribute, 1);
+    }
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    allocate(capacity > 0 ? capacity : 1);
+    sprites.reserve(section_capacity);
+
+    std::vector<std::string> defines;
+    if (textured) {defines.push_back("TEXTURED");}
+    shader = ShaderCache::instance().get("/home/miles/dev/platformer/src/tile_vertex.glsl","/home/miles/dev/platformer/src/tile_fragment.glsl", defines);
+}
+
+SpriteBatch::~SpriteBatch() {
+    // release our hold on the shared shader
+    shader.reset();
+
+    for (GLsync& fence : fences) {
+        if (fence) {glDeleteSync(fence);}
+    }
+
+    // unnallocate opengl stuff
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    glDeleteBuffers(1, &ring_VBO);
+    glDeleteVertexArrays(1, &VAO);
+}
+
+void SpriteBatch::allocate(std::size_t capacity) {
+    // the old storage is orphaned, the driver keeps it alive for draws still reading it
+    for (GLsync& fence : fences) {
+        if (fence) {glDeleteSync(fence);}
+        fence = nullptr;
+    }
+
+    section_capacity = capacity;
+    section = 0;
+
+    glBindBuffer(GL_ARRAY_BUFFER, ring_VBO);
+    glBufferData(GL_ARRAY_BUFFER, SECTIONS * section_capacity * sizeof(TileInstance), nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void SpriteBatch::wait_for(int index) {
+    GLsync& fence = fences[index];
+    if (fence == nullptr) {return;}
+
+    // the first check does not wait at all, so a stall is only counted when one happens
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        TRACE_SCOPE("SpriteBatch::stall");
+        ++stalls;
+        do {
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);   // 1 ms
+        } while (status == GL_TIMEOUT_EXPIRED);
+    }
+
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void SpriteBatch::draw() {
+    TRACE_SCOPE("SpriteBatch::draw");
+
+    if (sprites.empty()) {return;}
+
+    // grow to the next power of two so a slowly growing crowd does not reallocate every frame
+    if (sprites.size() > section_capacity) {
+        std::size_t capacity = section_capacity;
+        while (capacity < sprites.size()) {capacity *= 2;}
+        allocate(capacity);
+    }
+
+    wait_for(section);
+
+    GLintptr offset = static_cast<GLintptr>(section * section_capacity * sizeof(TileInstance));
+    GLsizeiptr bytes = static_cast<GLsizeiptr>(sprites.size() * sizeof(TileInstance));
+
+    // the fence already says the GPU is done with this part, so skip the driver's own check
+    glBindBuffer(GL_ARRAY_BUFFER, ring_VBO);
+    void* target = glMapBufferRange(GL_ARRAY_BUFFER, offset, bytes,
+                                    GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+    if (target == nullptr) {
+        // the driver could not map it, fall back to a plain copy
+        glBufferSubData(GL_ARRAY_BUFFER, offset, bytes, sprites.data());
+    } else {
+        std::memcpy(target, sprites.data(), static_cast<std::size_t>(bytes));
+
+        // GL_FALSE means the store was lost while mapped (eg a mode switch), so write it again
+        if (glUnmapBuffer(GL_ARRAY_BUFFER) == GL_FALSE) {
+            glBufferSubData(GL_ARRAY_BUFFER, offset, bytes, sprites.data());
+        }
+    }
+
+    // point the instance attributes at this section, there is no base instance in 3.3
+    glBindVertexArray(VAO);
+    const char* base = reinterpret_cast<const char*>(offset);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(TileInstance), base + offsetof(TileInstance, offset));
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(TileInstance), base + offsetof(TileInstance, size));
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(TileInstance), base + offsetof(TileInstance, color));
+    glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(TileInstance), base + offsetof(TileInstance, layer));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    shader->use();
+    glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr, static_cast<GLsizei>(sprites.size()));
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+
+    // the section may be written again once the GPU is past this fence
+    fences[section] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    section = (section + 1) % SECTIONS;
+
+    sprites.clear();
+}
+
+#endif
+/* EOF */
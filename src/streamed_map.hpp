@@ -0,0 +1,135 @@
+/// @brief Draws a StreamingWorld. Every resident region is baked into MapChunks when it arrives
+/// and the chunks are deleted when it is evicted. Baking is spread over frames, a few regions
+/// per update, so a burst of arrivals never stalls a single frame
+#ifndef STREAMED_MAP_CLASS
+#define STREAMED_MAP_CLASS
+
+#include <deque>
+#include <vector>
+#include <memory>
+#include "streaming_world.hpp"
+#include "map_chunk.hpp"
+#include "shader_cache.hpp"
+#include "tile_textures.hpp"
+#include "view_rect.hpp"
+#include "trace.hpp"
+
+static_assert(REGION_SIZE_MULTIPLE % MapChunk::SIZE == 0, "regions must hold whole chunks");
+
+class StreamedMap {
+public:
+    /// @brief regions baked into chunks per update at most
+    static const int BUILDS_PER_UPDATE = 2;
+
+    /// @param world the world to draw, must outlive this
+    /// @param tile_size size of a tile in world space
+    StreamedMap(const StreamingWorld& world, float tile_size);
+    ~StreamedMap();
+
+    /// @brief bake regions that arrived and free the chunks of evicted ones, call after StreamingWorld::update
+    /// @param events the events taken from the world this frame
+    void update(const std::vector<StreamingWorld::RegionEvent>& events);
+
+    /// @brief draw the baked chunks overlapping the visible rect, using the camera set in the CameraBuffer
+    void draw(const ViewRect& visible);
+
+    /// @brief the tile images to draw with, must be set before the first draw and outlive the map
+    void set_textures(const TileTextures* tile_textures) {textures = tile_textures;}
+
+private:
+    /// @brief delete the chunks of a region
+    void release(int region);
+
+    const StreamingWorld& world;
+    float tile_size;
+    int chunks_per_side;        // chunks across one region
+
+    std::vector<std::vector<MapChunk*>> region_chunks;  // per region, empty while not baked
+    std::deque<int> to_build;                           // regions that arrived and wait to be baked
+
+    std::shared_ptr<Shader> chunk_shader;
+    const TileTextures* textures;
+};
+
+StreamedMap::StreamedMap(const StreamingWorld& world, float tile_size) : world(world), tile_size(tile_size), textures(nullptr) {
+    chunks_per_side = world.tiles_per_region() / MapChunk::SIZE;
+    region_chunks.resize(static_cast<std::size_t>(world.regions_wide()) * world.regions_high());
+
+    chunk_shader = ShaderCache::instance().get("/home/miles/dev/platformer/src/tile_vertex.glsl","/home/miles/dev/platformer/src/tile_fragment.glsl", {"TEXTURED"});
+}
+
+StreamedMap::~StreamedMap() {
+    for (std::size_t region = 0; region < region_chunks.size(); ++region) {
+        release(static_cast<int>(region));
+    }
+}
+
+void StreamedMap::update(const std::vector<StreamingWorld::RegionEvent>& events) {
+    TRACE_SCOPE("StreamedMap::update");
+
+    for (const StreamingWorld::RegionEvent& event : events) {
+        if (event.loaded) {to_build.push_back(event.region);}
+        else {release(event.region);}
+    }
+
+    int built = 0;
+    while (!to_build.empty() && built < BUILDS_PER_UPDATE) {
+        int region = to_build.front();
+        to_build.pop_front();
+
+        // it may have been evicted again before its turn came
+        const TileGrid* cells = world.region_cells(region);
+        if (cells == nullptr || !region_chunks[region].empty()) {continue;}
+
+        int origin_x = (region % world.regions_wide()) * world.tiles_per_region();
+        int origin_y = (region / world.regions_wide()) * world.tiles_per_region();
+        for (int y = 0; y < chunks_per_side; ++y) {
+            for (int x = 0; x < chunks_per_side; ++x) {
+                MapChunk* chunk = new MapChunk(origin_x / MapChunk::SIZE + x, origin_y / MapChunk::SIZE + y);
+                chunk->build(*cells, tile_size, origin_x, origin_y);
+                region_chunks[region].push_back(chunk);
+            }
+        }
+        ++built;
+    }
+}
+
+void StreamedMap::draw(const ViewRect& visible) {
+    TRACE_SCOPE("StreamedMap::draw");
+
+    ViewRect rect = visible.clamped(world.width(), world.height());
+    if (rect.min_x >= rect.max_x || rect.min_y >= rect.max_y) {return;}
+
+    chunk_shader->use();
+    textures->bind();
+
+    // chunk vertices are already in world space, so no offset and a unit scale
+    glVertexAttrib2f(1, 0.0f, 0.0f);
+    glVertexAttrib2f(2, 1.0f, 1.0f);
+
+    int size = world.tiles_per_region();
+    for (int region_y = rect.min_y / size; region_y <= (rect.max_y - 1) / size; ++region_y) {
+        for (int region_x = rect.min_x / size; region_x <= (rect.max_x - 1) / size; ++region_x) {
+            for (const MapChunk* chunk : region_chunks[region_y * world.regions_wide() + region_x]) {
+                if (rect.overlaps(chunk->x() * MapChunk::SIZE, chunk->y() * MapChunk::SIZE,
+                                  (chunk->x() + 1) * MapChunk::SIZE, (chunk->y() + 1) * MapChunk::SIZE)) {
+                    chunk->draw();
+                }
+            }
+        }
+    }
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+}
+
+void StreamedMap::release(int region) {
+    for (MapChunk*& chunk : region_chunks[region]) {
+        delete chunk;
+        chunk = nullptr;
+    }
+    region_chunks[region].clear();
+}
+
+#endif
+/* EOF */
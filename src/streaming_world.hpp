@@ -0,0 +1,328 @@
+/// @brief A level that is streamed in around a point instead of loaded whole. Regions of a
+/// world file near the focus (the player) are read on a background thread, and regions far
+/// from it are dropped again once the resident ones go over a memory budget.
+///
+/// Everything is read and changed from the main thread except the file reads, which hand
+/// their cells back through a queue that update() empties. Nothing here ever waits on the
+/// loader thread (unless blocking mode is on), so a region that has not arrived yet simply
+/// reads as NOT_RESIDENT. Holds no GL objects, StreamedMap draws the resident regions
+#ifndef STREAMING_WORLD_CLASS
+#define STREAMING_WORLD_CLASS
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+#include "tile_grid.hpp"
+#include "world_file.hpp"
+#include "trace.hpp"
+
+class StreamingWorld {
+public:
+    /// @brief what a cell in a region that is not loaded yet reads as.
+    /// it counts as solid, so the player can never fall into or walk through a region before it arrives
+    static const TileGrid::TileId NOT_RESIDENT = 1;
+
+    /// @brief a region that arrived or was dropped, for anything that keeps its own copy (eg StreamedMap)
+    struct RegionEvent {
+        int region;
+        bool loaded;        // false if it was evicted
+    };
+
+    StreamingWorld();
+    ~StreamingWorld();
+
+    StreamingWorld(const StreamingWorld&) = delete;
+    StreamingWorld& operator=(const StreamingWorld&) = delete;
+
+    /// @brief open a world file and start the loader thread, no regions are loaded yet
+    /// @param path a world file (see write_world_file)
+    /// @param budget_bytes most bytes of region cells to keep resident, regions near the focus are kept even past it
+    /// @param load_radius regions within this many tiles of the focus are loaded
+    /// @return false if the file could not be opened
+    bool open(const std::string& path, std::size_t budget_bytes, float load_radius);
+
+    /// @brief ask for the regions around the focus, take in any that have arrived, and evict far ones.
+    /// call once per frame, it never waits for a region (unless set_blocking is on)
+    /// @param focus world position to stream around, in tiles
+    void update(glm::vec2 focus);
+
+    /// @brief make update() wait until every region around the focus is in,
+    /// so runs that need to be deterministic (headless, replays) never see NOT_RESIDENT near the player
+    void set_blocking(bool blocking) {blocking_loads = blocking;}
+
+    /// @brief tile id of a cell, NOT_RESIDENT if its region is not loaded. the cell must be inside the world
+    TileGrid::TileId at(int x, int y) const {
+        const Region& region = regions[region_of(x, y)];
+        if (region.state == Region::RESIDENT) {return region.cells.at(x % region_size, y % region_size);}
+        return region.state == Region::EMPTY ? 0 : NOT_RESIDENT;
+    }
+
+    /// @brief true if the cell is inside the world and not empty, unloaded cells count as solid
+    bool solid(int x, int y) const {return in_bounds(x, y) && at(x, y) != 0;}
+
+    bool in_bounds(int x, int y) const {return x >= 0 && y >= 0 && x < world_width && y < world_height;}
+
+    /// @brief true if the region holding the cell is loaded (or has no tiles)
+    bool resident(int x, int y) const {return regions[region_of(x, y)].state >= Region::RESIDENT;}
+
+    /// @brief size of the whole world in tiles
+    int width() const {return world_width;}
+    int height() const {return world_height;}
+
+    /// @brief tiles per region side, and the number of regions across and up
+    int tiles_per_region() const {return region_size;}
+    int regions_wide() const {return file.regions_wide();}
+    int regions_high() const {return file.regions_high();}
+
+    /// @brief the cells of a resident region, nullptr if it is not resident
+    const TileGrid* region_cells(int region) const {
+        return regions[region].state == Region::RESIDENT ? &regions[region].cells : nullptr;
+    }
+
+    /// @brief move the regions that arrived or were evicted since the last call into events
+    void take_events(std::vector<RegionEvent>& events);
+
+    /// @brief regions holding cells right now, and the bytes they use
+    int resident_count() const {return resident_regions;}
+    std::size_t resident_bytes() const {return static_cast<std::size_t>(resident_regions) * region_bytes;}
+
+    /// @brief regions asked for that have not arrived yet
+    int pending_count() const {return pending_regions;}
+
+private:
+    struct Region {
+        // EMPTY regions have no tiles on disk, so they are always resident and never loaded
+        enum State {NOT_LOADED, REQUESTED, FAILED, RESIDENT, EMPTY};
+        State state = NOT_LOADED;
+        TileGrid cells;
+        bool wanted = false;    // near the focus as of the last update
+    };
+
+    /// @brief a region read by the loader thread
+    struct LoadedRegion {
+        int region;
+        bool ok;
+        TileGrid cells;
+    };
+
+    int region_of(int x, int y) const {return (y / region_size) * file.regions_wide() + x / region_size;}
+
+    /// @brief the loader thread, reads requested regions until told to stop
+    void load_regions();
+
+    /// @brief move regions the loader has finished into the world
+    void take_loaded();
+
+    /// @brief drop the farthest unwanted regions until the resident ones fit the budget
+    void evict(glm::vec2 focus);
+
+    WorldFile file;
+    int world_width;
+    int world_height;
+    int region_size;
+    std::size_t region_bytes;
+
+    std::vector<Region> regions;
+    std::vector<RegionEvent> events;
+    int resident_regions;
+    int pending_regions;
+
+    std::size_t budget;
+    float radius;
+    bool blocking_loads;
+    bool warned_budget;
+
+    // shared with the loader thread
+    std::thread loader;
+    std::mutex mutex;
+    std::condition_variable wake_loader;
+    std::condition_variable region_loaded;
+    std::deque<int> requests;
+    std::vector<LoadedRegion> loaded;
+    bool stopping;
+};
+
+StreamingWorld::StreamingWorld()
+    : world_width(0), world_height(0), region_size(1), region_bytes(0), resident_regions(0), pending_regions(0),
+      budget(0), radius(0.0f), blocking_loads(false), warned_budget(false), stopping(false) {}
+
+StreamingWorld::~StreamingWorld() {
+    if (loader.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake_loader.notify_all();
+        loader.join();
+    }
+}
+
+bool StreamingWorld::open(const std::string& path, std::size_t budget_bytes, float load_radius) {
+    if (loader.joinable() || !file.open(path)) {return false;}
+
+    world_width = file.width();
+    world_height = file.height();
+    region_size = file.region_size();
+    region_bytes = TileGrid::storage_size(region_size, region_size);
+    budget = budget_bytes;
+    radius = load_radius;
+
+    regions = std::vector<Region>(static_cast<std::size_t>(file.regions_wide()) * file.regions_high());
+    for (std::size_t i = 0; i < regions.size(); ++i) {
+        if (file.entry(static_cast<int>(i)).size == 0) {regions[i].state = Region::EMPTY;}
+    }
+
+    loader = std::thread(&StreamingWorld::load_regions, this);
+    return true;
+}
+
+void StreamingWorld::update(glm::vec2 focus) {
+    TRACE_SCOPE("StreamingWorld::update");
+
+    take_loaded();
+
+    // every region overlapping the square around the focus is wanted, the nearest asked for first
+    int first_x = std::max(0, static_cast<int>((focus.x - radius) / region_size));
+    int first_y = std::max(0, static_cast<int>((focus.y - radius) / region_size));
+    int last_x = std::min(file.regions_wide() - 1, static_cast<int>((focus.x + radius) / region_size));
+    int last_y = std::min(file.regions_high() - 1, static_cast<int>((focus.y + radius) / region_size));
+
+    for (Region& region : regions) {region.wanted = false;}
+
+    std::vector<std::pair<float, int>> wanted;
+    for (int y = first_y; y <= last_y; ++y) {
+        for (int x = first_x; x <= last_x; ++x) {
+            int index = y * file.regions_wide() + x;
+            regions[index].wanted = true;
+            if (regions[index].state != Region::NOT_LOADED) {continue;}
+
+            glm::vec2 center = (glm::vec2(x, y) + 0.5f) * static_cast<float>(region_size);
+            wanted.emplace_back(glm::length(center - focus), index);
+        }
+    }
+    std::sort(wanted.begin(), wanted.end());
+
+    if (!wanted.empty()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const auto& request : wanted) {
+                requests.push_back(request.second);
+                regions[request.second].state = Region::REQUESTED;
+                ++pending_regions;
+            }
+        }
+        wake_loader.notify_one();
+    }
+
+    if (blocking_loads) {
+        while (pending_regions > 0) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                region_loaded.wait(lock, [this] {return !loaded.empty();});
+            }
+            take_loaded();
+        }
+    }
+
+    evict(focus);
+}
+
+void StreamingWorld::take_events(std::vector<RegionEvent>& out) {
+    out.insert(out.end(), events.begin(), events.end());
+    events.clear();
+}
+
+void StreamingWorld::load_regions() {
+    while (true) {
+        int region;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake_loader.wait(lock, [this] {return stopping || !requests.empty();});
+            if (stopping) {return;}
+
+            region = requests.front();
+            requests.pop_front();
+        }
+
+        LoadedRegion result;
+        result.region = region;
+        {
+            TRACE_SCOPE("WorldFile::read_region");
+            result.ok = file.read_region(region, result.cells);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            loaded.push_back(std::move(result));
+        }
+        region_loaded.notify_one();
+    }
+}
+
+void StreamingWorld::take_loaded() {
+    std::vector<LoadedRegion> arrived;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        arrived.swap(loaded);
+    }
+
+    for (LoadedRegion& result : arrived) {
+        Region& region = regions[result.region];
+        --pending_regions;
+
+        if (!result.ok) {
+            // leave it reading as NOT_RESIDENT rather than retrying a broken file every frame
+            std::cerr << "could not read world region " << result.region << ", it will stay solid" << std::endl;
+            region.state = Region::FAILED;
+            continue;
+        }
+
+        region.cells = std::move(result.cells);
+        region.state = Region::RESIDENT;
+        ++resident_regions;
+        events.push_back(RegionEvent{result.region, true});
+    }
+}
+
+void StreamingWorld::evict(glm::vec2 focus) {
+    while (resident_bytes() > budget) {
+        // the farthest region that is not needed right now
+        int farthest = -1;
+        float farthest_distance = -1.0f;
+        for (std::size_t i = 0; i < regions.size(); ++i) {
+            if (regions[i].state != Region::RESIDENT || regions[i].wanted) {continue;}
+
+            glm::vec2 center = (glm::vec2(static_cast<int>(i) % file.regions_wide(), static_cast<int>(i) / file.regions_wide()) + 0.5f)
+                               * static_cast<float>(region_size);
+            float distance = glm::length(center - focus);
+            if (distance > farthest_distance) {
+                farthest = static_cast<int>(i);
+                farthest_distance = distance;
+            }
+        }
+
+        if (farthest == -1) {
+            if (!warned_budget) {
+                std::cerr << "world budget of " << budget << " bytes is smaller than the regions around the player" << std::endl;
+                warned_budget = true;
+            }
+            return;
+        }
+
+        Region& region = regions[farthest];
+        region.cells = TileGrid();
+        region.state = Region::NOT_LOADED;
+        --resident_regions;
+        events.push_back(RegionEvent{farthest, false});
+    }
+}
+
+#endif
+/* EOF */
@@ -7,41 +7,33 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include "shader.hpp"
+#include "shader_cache.hpp"
+#include "aabb.hpp"
 
 
 class Tile {
 public:
 
     Tile(float left = 0.0f, float bottom = 0.0f, float width = 0.0f, float height = 0.0f, 
-         glm::mat4 projection = glm::mat4(1.0f), glm::vec3 tile_color = glm::vec3(1.0f));
+         glm::vec3 tile_color = glm::vec3(1.0f));
 
     ~Tile();
 
-    /// @brief Draw the tile to the screen
-    void draw(glm::mat4 view);
+    /// @brief Draw the tile to the screen, using the camera set in the CameraBuffer
+    void draw();
 
     /// @brief Checks if two existing tiles are overlapping, return true if they are
     friend bool colliding(Tile& tile_one, Tile& tile_two);
 
 
-    /* SET SHADER UNIFORMS */
+    /* SET COLOR */
 
-    /// @brief Calculate and set the transform matrix given the position 
-    /// run once on initialization, and when repositioned
-    /// for static tiles, this won't ever need to be called again
-    void set_transform_matrix();
+    /// @brief set the color of the tile, sent to the shader as a vertex attribute when drawn
+    /// @param tile_color vec3 of the color of the tile
+    void set_color(glm::vec3 tile_color) {color = tile_color;}
 
-    /// @brief set the projection matrix being used. 
-    /// called once when started, otherwise only run when called
-    void set_projection_matrix(glm::mat4 projection) {shader->setMat4("projection", projection);}
-
-    /// @brief set the color uniform for the tile
-    /// run once at start, only needs to be run again if color changes
-    /// @param color vec3 of the color of the tile
-    void set_color(glm::vec3 color) {shader->setVec3("color", color);}
-
-    /// @brief set the view matrix being used for the camera
-    void set_view_matrix(glm::mat4 view) {shader->setMat4("view", view);}
+    /* COLOR ACCESS */
+    glm::vec3 tile_color() const {return color;}
 
     /* SIZE ACCESS */
     /// @brief size in coordinate space of the tile
@@ -49,6 +41,9 @@ public:
     float width() const {return size.x;}
     float height() const {return size.y;}
     
+    /// @brief the bounds of the tile as a plain box, for collision
+    AABB box() const {return AABB{bottom_left(), top_right()};}
+
     /* POSITION ACCESS*/
     // 5 main points
     glm::vec2 bottom_left() const {return pos_bottomleft;}
@@ -69,21 +64,21 @@ public:
 
     /* POSITION SETTING */
     // 5 main points
-    void set_bottom_left(glm::vec2 pos)  {pos_bottomleft = pos; set_transform_matrix();} 
-    void set_bottom_right(glm::vec2 pos) {pos_bottomleft = glm::vec2(pos.x - width(), pos.y); set_transform_matrix();} 
-    void set_top_left(glm::vec2 pos) {pos_bottomleft = glm::vec2(pos.x, pos.y - height()); set_transform_matrix();} 
-    void set_top_right(glm::vec2 pos) {pos_bottomleft = glm::vec2(pos.x - width(), pos.y - height()); set_transform_matrix();} 
-    void set_center(glm::vec2 pos) {pos_bottomleft = glm::vec2(pos.x - (width() / 2.0f), pos.y - (height() / 2.0f)); set_transform_matrix();}
+    void set_bottom_left(glm::vec2 pos)  {pos_bottomleft = pos;} 
+    void set_bottom_right(glm::vec2 pos) {pos_bottomleft = glm::vec2(pos.x - width(), pos.y);} 
+    void set_top_left(glm::vec2 pos) {pos_bottomleft = glm::vec2(pos.x, pos.y - height());} 
+    void set_top_right(glm::vec2 pos) {pos_bottomleft = glm::vec2(pos.x - width(), pos.y - height());} 
+    void set_center(glm::vec2 pos) {pos_bottomleft = glm::vec2(pos.x - (width() / 2.0f), pos.y - (height() / 2.0f));}
 
     // y - values
-    void set_top(float y) {pos_bottomleft = glm::vec2(left(), y - height()); set_transform_matrix();}
-    void set_mid_y(float y) {pos_bottomleft = glm::vec2(left(), y - (height() / 2.0f)); set_transform_matrix();}
-    void set_bottom(float y) {pos_bottomleft = glm::vec2(left(), y); set_transform_matrix();}
+    void set_top(float y) {pos_bottomleft = glm::vec2(left(), y - height());}
+    void set_mid_y(float y) {pos_bottomleft = glm::vec2(left(), y - (height() / 2.0f));}
+    void set_bottom(float y) {pos_bottomleft = glm::vec2(left(), y);}
 
     // x - values
-    void set_right(float x) {pos_bottomleft = glm::vec2(x - width(), bottom()); set_transform_matrix();}
-    void set_mid_x(float x) {pos_bottomleft = glm::vec2(x - (width() / 2.0f), bottom()); set_transform_matrix();}
-    void set_left(float x) {pos_bottomleft = glm::vec2(x, bottom()); set_transform_matrix();}
+    void set_right(float x) {pos_bottomleft = glm::vec2(x - width(), bottom());}
+    void set_mid_x(float x) {pos_bottomleft = glm::vec2(x - (width() / 2.0f), bottom());}
+    void set_left(float x) {pos_bottomleft = glm::vec2(x, bottom());}
     
 
 
@@ -98,15 +93,18 @@ private:
 
     glm::vec2 pos_bottomleft;   // coordinate in pixel where the bottom left of the tile is placed
 
-    Shader* shader;
+    glm::vec3 color;   // color of the tile
+
+    std::shared_ptr<Shader> shader;   // shared with every other user of the same program
 };
 
 Tile::Tile(float left, float bottom, float width, float height, 
-         glm::mat4 projection, glm::vec3 tile_color) {
+         glm::vec3 tile_color) {
 
     // set member variables
     size = glm::vec2(width, height);
     pos_bottomleft = glm::vec2(left, bottom);
+    color = tile_color;
 
 
     // create Vertex Array
@@ -146,22 +144,14 @@ Tile::Tile(float left, float bottom, float width, float height,
     glBindVertexArray(0); // Unbind VAO for now
 
     
-    // Create Shader
-
-    shader = new Shader("/home/miles/dev/platformer/src/tile_vertex.glsl","/home/miles/dev/platformer/src/tile_fragment.glsl");
-    shader->use();
-
-    // Set Uniforms
-    set_projection_matrix(projection);
-    set_color(tile_color);
-    set_transform_matrix();
-    set_view_matrix(glm::mat4(1.0f));
-    glUseProgram(0);
+    // Get Shader, compiled once and shared by every tile
+    // the camera matrices come from the shared Camera block, so there are no uniforms to set
+    shader = ShaderCache::instance().get("/home/miles/dev/platformer/src/tile_vertex.glsl","/home/miles/dev/platformer/src/tile_fragment.glsl");
 }
 
 Tile::~Tile() {
-    // destroy shader
-    delete shader;
+    // release our hold on the shared shader
+    shader.reset();
 
     // unnallocate opengl stuff
     glDeleteBuffers(1, &VBO);
@@ -169,13 +159,16 @@ Tile::~Tile() {
     glDeleteVertexArrays(1, &VAO);
 }
 
-void Tile::draw(glm::mat4 view) {
+void Tile::draw() {
 
     glBindVertexArray(VAO);
     shader->use();
 
-    // set the view matrix as the camera moves
-    set_view_matrix(view);
+    // the shader reads position, size and color as per-instance attributes.
+    // a lone tile has no instance buffer, so give the disabled arrays a constant value instead
+    glVertexAttrib2f(1, left(), bottom());
+    glVertexAttrib2f(2, width(), height());
+    glVertexAttrib3f(3, color.x, color.y, color.z);
 
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
 
@@ -183,32 +176,14 @@ void Tile::draw(glm::mat4 view) {
     glUseProgram(0);
 }
 
-void Tile::set_transform_matrix() {
-
-    shader->use();
-
-    glm::mat4 transform{1.0f};
-    transform = glm::translate(transform, glm::vec3(left(), bottom(), 0.0f));
-    transform = glm::scale(transform, glm::vec3(width(), height(), 1.0f));
-    shader->setMat4("trans", transform);
-
-    glUseProgram(0);
-}
-
 bool colliding(Tile& tile_one, Tile& tile_two) {
     // no collision with a nullptr
     if(&tile_one == nullptr || &tile_two == nullptr) {return false;}
     // if same tile, return false
     if (&tile_one == &tile_two){return false;}
 
-    // check horizontal bounds
-    if (tile_one.left() >= tile_two.right() || tile_one.right() <= tile_two.left()) {return false;}  // not overlapping x
-
-    // check vertical bounds
-    if (tile_one.top() < tile_two.bottom() || tile_one.bottom() >= tile_two.top()) {return false;} // not overlapping y
-
-    // if not early return, then two separate existing tiles are overlapping x and y
-    return true;
+    // two separate existing tiles, compare their bounds
+    return colliding(tile_one.box(), tile_two.box());
 }
 
 #endif
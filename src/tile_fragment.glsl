@@ -1,8 +1,17 @@
 #version 330 core
 
-uniform vec3 color;
+#ifdef TEXTURED
+uniform sampler2DArray tile_images;     // TileTextures, left on texture unit 0
+in vec3 tile_uv;
+#else
+in vec3 tile_color;
+#endif
 out vec4 FragColor;
 
 void main() {
-    FragColor = vec4(color, 1.0);
-}
\ No newline at end of file
+#ifdef TEXTURED
+    FragColor = texture(tile_images, tile_uv);
+#else
+    FragColor = vec4(tile_color, 1.0);
+#endif
+}
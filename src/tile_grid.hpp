@@ -0,0 +1,192 @@
+/// @brief Compact storage for the tiles of a map. Every cell is a one byte tile id
+/// (0 is empty), and cells are stored in BLOCK_SIZE x BLOCK_SIZE blocks so that
+/// neighbouring cells above and below each other sit in the same few cache lines.
+/// Lookups are O(1) shifts and masks, and the grid holds no GL objects,
+/// so drawing is left to a separate render representation (MapChunk, TileRenderer).
+/// The cells can also be a read only view of memory owned by someone else (eg a memory
+/// mapped compiled map), which is copied into the grid the first time a cell is set
+#ifndef TILE_GRID_CLASS
+#define TILE_GRID_CLASS
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+
+class TileGrid {
+public:
+    /// @brief id stored in every cell, 0 means empty
+    typedef std::uint8_t TileId;
+
+    /// @brief cells per block side, as a power of two so indexing is just shifts
+    static const int BLOCK_BITS = 4;
+    static const int BLOCK_SIZE = 1 << BLOCK_BITS;                  // 16
+    static const int BLOCK_CELLS = BLOCK_SIZE * BLOCK_SIZE;         // 256 bytes per block
+
+    TileGrid() : grid_width(0), grid_height(0), blocks_wide(0), blocks_high(0), view(nullptr) {}
+    TileGrid(int width, int height) : view(nullptr) {resize(width, height);}
+
+    TileGrid(const TileGrid& other) : view(nullptr) {*this = other;}
+    TileGrid(TileGrid&& other) : view(nullptr) {*this = std::move(other);}
+    TileGrid& operator=(const TileGrid& other);
+    TileGrid& operator=(TileGrid&& other);
+
+    /// @brief resize the grid, every cell is cleared to empty
+    /// @param width number of columns
+    /// @param height number of rows, row 0 is the bottom of the map
+    void resize(int width, int height);
+
+    /// @brief use cells stored somewhere else in place, with no copy
+    /// @param width number of columns
+    /// @param height number of rows
+    /// @param data cells in the block layout of index(), storage_size() bytes long
+    /// @param owner keeps the memory behind data alive for as long as the grid uses it
+    void view_cells(int width, int height, const TileId* data, std::shared_ptr<const void> owner);
+
+    /// @brief tile id of a cell, the cell must be inside the grid
+    TileId at(int x, int y) const {return view[index(x, y)];}
+
+    /// @brief set the tile id of a cell, the cell must be inside the grid.
+    /// a grid viewing outside memory copies it first
+    void set(int x, int y, TileId id) {
+        if (owner) {own_cells();}
+        cells[index(x, y)] = id;
+    }
+
+    /// @brief true if the cell is inside the grid
+    bool in_bounds(int x, int y) const {return x >= 0 && y >= 0 && x < grid_width && y < grid_height;}
+
+    /// @brief true if the cell is inside the grid and not empty, outside the grid is never solid
+    bool solid(int x, int y) const {return in_bounds(x, y) && at(x, y) != 0;}
+
+    /// @brief size of the grid in cells
+    int width() const {return grid_width;}
+    int height() const {return grid_height;}
+    bool empty() const {return grid_width == 0 || grid_height == 0;}
+
+    /// @brief number of cells that are not empty
+    std::size_t solid_count() const;
+
+    /// @brief bytes used by the cells, including the padding of partial blocks on the edges
+    std::size_t memory_bytes() const {return storage_size(grid_width, grid_height) * sizeof(TileId);}
+
+    /// @brief the cells in block layout, memory_bytes() long
+    const TileId* data() const {return view;}
+
+    /// @brief true if the cells are a view of memory the grid does not own
+    bool is_view() const {return owner != nullptr;}
+
+    /// @brief number of cells a grid of this size stores, including padding
+    static std::size_t storage_size(int width, int height) {
+        std::size_t wide = static_cast<std::size_t>((width + BLOCK_SIZE - 1) >> BLOCK_BITS);
+        std::size_t high = static_cast<std::size_t>((height + BLOCK_SIZE - 1) >> BLOCK_BITS);
+        return wide * high * BLOCK_CELLS;
+    }
+
+    /// @brief index of a cell in the block layout
+    std::size_t index(int x, int y) const {
+        std::size_t block = static_cast<std::size_t>(y >> BLOCK_BITS) * blocks_wide + static_cast<std::size_t>(x >> BLOCK_BITS);
+        std::size_t inside = static_cast<std::size_t>(((y & (BLOCK_SIZE - 1)) << BLOCK_BITS) | (x & (BLOCK_SIZE - 1)));
+        return (block << (2 * BLOCK_BITS)) | inside;
+    }
+
+private:
+    /// @brief copy viewed cells into the grid's own storage
+    void own_cells();
+
+    /// @brief set the size and block counts, leaving the cells alone
+    void set_size(int width, int height);
+
+    int grid_width;
+    int grid_height;
+    int blocks_wide;
+    int blocks_high;
+
+    std::vector<TileId> cells;     // blocks_wide * blocks_high blocks of BLOCK_CELLS cells, row major
+    const TileId* view;            // the cells in use, either cells.data() or outside memory
+    std::shared_ptr<const void> owner;  // set while viewing outside memory
+};
+
+TileGrid& TileGrid::operator=(const TileGrid& other) {
+    if (this == &other) {return *this;}
+
+    set_size(other.grid_width, other.grid_height);
+    owner = other.owner;
+    if (owner) {
+        // views share the outside memory, it is read only
+        cells.clear();
+        view = other.view;
+    } else {
+        cells = other.cells;
+        view = cells.data();
+    }
+    return *this;
+}
+
+TileGrid& TileGrid::operator=(TileGrid&& other) {
+    if (this == &other) {return *this;}
+
+    set_size(other.grid_width, other.grid_height);
+    owner = std::move(other.owner);
+    cells = std::move(other.cells);
+    view = owner ? other.view : cells.data();
+
+    other.set_size(0, 0);
+    other.cells.clear();
+    other.owner.reset();
+    other.view = other.cells.data();
+    return *this;
+}
+
+void TileGrid::set_size(int width, int height) {
+    grid_width = width < 0 ? 0 : width;
+    grid_height = height < 0 ? 0 : height;
+
+    // round up so partial blocks on the top and right edges are kept
+    blocks_wide = (grid_width + BLOCK_SIZE - 1) >> BLOCK_BITS;
+    blocks_high = (grid_height + BLOCK_SIZE - 1) >> BLOCK_BITS;
+}
+
+void TileGrid::resize(int width, int height) {
+    set_size(width, height);
+
+    owner.reset();
+    cells.assign(storage_size(grid_width, grid_height), 0);
+    view = cells.data();
+}
+
+void TileGrid::view_cells(int width, int height, const TileId* data, std::shared_ptr<const void> data_owner) {
+    set_size(width, height);
+
+    // with nothing keeping the memory alive it has to be copied
+    if (!data_owner) {
+        owner.reset();
+        cells.assign(data, data + storage_size(grid_width, grid_height));
+        view = cells.data();
+        return;
+    }
+
+    cells.clear();
+    cells.shrink_to_fit();
+    owner = std::move(data_owner);
+    view = data;
+}
+
+void TileGrid::own_cells() {
+    cells.assign(view, view + storage_size(grid_width, grid_height));
+    owner.reset();
+    view = cells.data();
+}
+
+std::size_t TileGrid::solid_count() const {
+    // padding cells past the edges are always 0, so they never count
+    std::size_t count = 0;
+    std::size_t size = storage_size(grid_width, grid_height);
+    for (std::size_t i = 0; i < size; ++i) {
+        if (view[i] != 0) {++count;}
+    }
+    return count;
+}
+
+#endif
+/* EOF */
@@ -0,0 +1,23 @@
+/// @brief The colors drawn for each tile id read from a map file
+#ifndef TILE_PALETTE
+#define TILE_PALETTE
+
+#include <glm/glm.hpp>
+
+/// @brief color of a non-empty tile id, unknown ids wrap around the palette
+glm::vec3 tile_color(int tile_id) {
+    static const glm::vec3 color_map[] = {
+        glm::vec3(0.7f, 0.0f, 0.0f),    // red
+        glm::vec3(0.0f, 0.7f, 0.0f),    // green
+        glm::vec3(0.7f, 0.7f, 0.0f),    // yellow
+        glm::vec3(0.0f, 0.0f, 0.7f),    // blue
+        glm::vec3(0.7f, 0.0f, 0.7f),    // magenta
+        glm::vec3(0.0f, 0.7f, 0.7f),    // cyan
+    };
+    const int color_count = sizeof(color_map) / sizeof(color_map[0]);
+
+    return color_map[(tile_id - 1) % color_count];
+}
+
+#endif
+/* EOF */
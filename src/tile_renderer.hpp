@@ -0,0 +1,165 @@
+/// @brief Draws a whole layer of static tiles with a single instanced draw call.
+/// Every tile shares one unit quad, and the per-tile offset, size and color
+/// (or texture layer, when textured) are stored in an instance buffer that is uploaded once
+#ifndef TILE_RENDERER_CLASS
+#define TILE_RENDERER_CLASS
+
+#include <glad/glad.h>
+#include <vector>
+#include <cstddef>                  // offsetof
+#include <glm/glm.hpp>
+#include "shader.hpp"
+#include "shader_cache.hpp"
+
+/// @brief per-instance data read by tile_vertex.glsl (attribute locations 1, 2, 3 and 4)
+struct TileInstance {
+    glm::vec2 offset;   // bottom left of the tile
+    glm::vec2 size;     // (width, height) of the tile
+    glm::vec3 color;    // color of the tile
+    float layer;        // layer in the TileTextures array, only read when textured
+};
+
+/// @brief make the unit quad every tile and sprite is drawn from, and point attributes 0 (position)
+/// and 5 (uv) of the bound vertex array at it. The vertex array keeps the index buffer bound
+/// @param VBO [out] the quad's vertex buffer, left bound to GL_ARRAY_BUFFER
+/// @param EBO [out] the quad's index buffer
+void create_unit_quad(unsigned int& VBO, unsigned int& EBO);
+
+class TileRenderer {
+public:
+    /// @param textured draw the tiles with their TileTextures layer instead of their color,
+    /// the array must be bound to texture unit 0 when drawing (see TileTextures::bind)
+    explicit TileRenderer(bool textured = false);
+    ~TileRenderer();
+
+    /// @brief replace the instance buffer with a new set of tiles
+    /// static layers only need to call this once after loading
+    /// @param instances the tiles to draw
+    void upload(const std::vector<TileInstance>& instances);
+
+    /// @brief draw every uploaded tile in one call, using the camera set in the CameraBuffer
+    void draw();
+
+    /// @brief number of tiles in the instance buffer
+    std::size_t count() const {return instance_count;}
+
+private:
+    unsigned int EBO;
+    unsigned int VBO;
+    unsigned int VAO;
+    unsigned int instance_VBO;
+
+    std::size_t instance_count;
+
+    std::shared_ptr<Shader> shader;   // shared with every other user of the same program
+};
+
+void create_unit_quad(unsigned int& VBO, unsigned int& EBO) {
+    float vertices[] = {
+        0.0f, 0.0f, 0.0f,
+        0.0f, 1.0f, 0.0f,
+        1.0f, 0.0f, 0.0f,
+        1.0f, 1.0f, 0.0f,
+    };
+
+    unsigned int indeces[] = {
+        0, 1, 2,
+        2, 3, 1
+    };
+
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indeces), indeces, GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), nullptr);
+    glEnableVertexAttribArray(0);
+
+    // the quad is a unit square, so its corners double as the texture coordinates
+    glVertexAttribPointer(5, 2, GL_FLOAT, GL_FALSE, 3 * sizeof(float), nullptr);
+    glEnableVertexAttribArray(5);
+}
+
+TileRenderer::TileRenderer(bool textured) {
+
+    instance_count = 0;
+
+    VAO = 0;
+    VBO = 0;
+    EBO = 0;
+    instance_VBO = 0;
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &instance_VBO);
+
+    glBindVertexArray(VAO);
+
+    // unit quad shared by every instance
+    create_unit_quad(VBO, EBO);
+
+    // per-instance attributes, advanced once per tile instead of once per vertex
+    glBindBuffer(GL_ARRAY_BUFFER, instance_VBO);
+
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(TileInstance), reinterpret_cast<void*>(offsetof(TileInstance, offset)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(1, 1);
+
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(TileInstance), reinterpret_cast<void*>(offsetof(TileInstance, size)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(TileInstance), reinterpret_cast<void*>(offsetof(TileInstance, color)));
+    glEnableVertexAttribArray(3);
+    glVertexAttribDivisor(3, 1);
+
+    glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(TileInstance), reinterpret_cast<void*>(offsetof(TileInstance, layer)));
+    glEnableVertexAttribArray(4);
+    glVertexAttribDivisor(4, 1);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // Get Shader, compiled once and shared by every tile
+    // the camera matrices come from the shared Camera block, so there are no uniforms to set
+    std::vector<std::string> defines;
+    if (textured) {defines.push_back("TEXTURED");}
+    shader = ShaderCache::instance().get("/home/miles/dev/platformer/src/tile_vertex.glsl","/home/miles/dev/platformer/src/tile_fragment.glsl", defines);
+}
+
+TileRenderer::~TileRenderer() {
+    // release our hold on the shared shader
+    shader.reset();
+
+    // unnallocate opengl stuff
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    glDeleteBuffers(1, &instance_VBO);
+    glDeleteVertexArrays(1, &VAO);
+}
+
+void TileRenderer::upload(const std::vector<TileInstance>& instances) {
+    instance_count = instances.size();
+
+    glBindBuffer(GL_ARRAY_BUFFER, instance_VBO);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(TileInstance), instances.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void TileRenderer::draw() {
+    if (instance_count == 0) {return;}  // nothing uploaded
+
+    glBindVertexArray(VAO);
+    shader->use();
+
+    glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr, static_cast<GLsizei>(instance_count));
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+}
+
+#endif
+/* EOF */
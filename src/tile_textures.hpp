@@ -0,0 +1,201 @@
+/// @brief The images drawn on map tiles, kept in one GL_TEXTURE_2D_ARRAY with a layer per tile id.
+/// A whole layer of mixed tiles then draws with one texture bound, each tile picking its layer
+/// from its vertex or instance data (see MapChunk and TileRenderer).
+///
+/// each layer is its own image, so unlike an atlas nothing can bleed in from a neighbouring tile:
+/// sampling clamps at the layer's edge and every mip level is made from that layer alone.
+/// Without a tile sheet the layers are drawn from the palette, so maps look as they did before
+#ifndef TILE_TEXTURES_CLASS
+#define TILE_TEXTURES_CLASS
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "tile_grid.hpp"
+#include "tile_palette.hpp"
+
+class TileTextures {
+public:
+    /// @brief width and height of a tile image in pixels
+    static const int TILE_PIXELS = 32;
+
+    /// @brief one layer for every non-empty tile id
+    static const int LAYERS = 255;
+
+    /// @brief starts out with the palette tiles
+    TileTextures();
+    ~TileTextures();
+
+    TileTextures(const TileTextures&) = delete;
+    TileTextures& operator=(const TileTextures&) = delete;
+
+    /// @brief texture layer a tile id is drawn with, the id must not be 0
+    static float layer_of(TileGrid::TileId id) {return static_cast<float>(id - 1);}
+
+    /// @brief the RGBA pixels of every layer, each a plain colored tile with a bevel
+    static std::vector<unsigned char> palette_layers();
+
+    /// @brief cut a binary PPM (P6) tile sheet into layers, the tiles are read left to right, top to bottom.
+    /// needs no GL, so it can run on a loader thread. a sheet with fewer tiles than LAYERS repeats them
+    /// @param data the whole file
+    /// @param layers [out] the RGBA pixels of every layer
+    /// @param error [out] what was wrong with the sheet
+    /// @return false if the sheet could not be read
+    static bool decode_sheet(const std::vector<char>& data, std::vector<unsigned char>& layers, std::string& error);
+
+    /// @brief make an array texture from the pixels of every layer, with mipmaps.
+    /// only makes a texture, so it may run on a context sharing objects with the main one
+    static unsigned int create_texture(const std::vector<unsigned char>& layers);
+
+    /// @brief draw with another texture from now on, taking it over and deleting the old one
+    void replace(unsigned int new_texture);
+
+    /// @brief bind the array to a texture unit, the textured tile shader reads unit 0
+    void bind(int unit = 0) const;
+
+    unsigned int id() const {return texture;}
+
+private:
+    unsigned int texture;
+};
+
+TileTextures::TileTextures() {
+    texture = create_texture(palette_layers());
+}
+
+TileTextures::~TileTextures() {
+    glDeleteTextures(1, &texture);
+}
+
+std::vector<unsigned char> TileTextures::palette_layers() {
+    const std::size_t layer_bytes = static_cast<std::size_t>(TILE_PIXELS) * TILE_PIXELS * 4;
+    std::vector<unsigned char> layers(layer_bytes * LAYERS);
+
+    for (int layer = 0; layer < LAYERS; ++layer) {
+        glm::vec3 color = tile_color(layer + 1);
+        unsigned char* pixels = &layers[layer_bytes * layer];
+
+        for (int y = 0; y < TILE_PIXELS; ++y) {
+            for (int x = 0; x < TILE_PIXELS; ++x) {
+                // light along the top and left edges, dark along the bottom and right
+                float shade = 1.0f;
+                int edge = 2;
+                if (x < edge || y >= TILE_PIXELS - edge) {shade = 1.3f;}
+                if (x >= TILE_PIXELS - edge || y < edge) {shade = 0.6f;}
+
+                unsigned char* pixel = pixels + (static_cast<std::size_t>(y) * TILE_PIXELS + x) * 4;
+                pixel[0] = static_cast<unsigned char>(std::min(color.x * shade, 1.0f) * 255.0f);
+                pixel[1] = static_cast<unsigned char>(std::min(color.y * shade, 1.0f) * 255.0f);
+                pixel[2] = static_cast<unsigned char>(std::min(color.z * shade, 1.0f) * 255.0f);
+                pixel[3] = 255;
+            }
+        }
+    }
+    return layers;
+}
+
+bool TileTextures::decode_sheet(const std::vector<char>& data, std::vector<unsigned char>& layers, std::string& error) {
+    // header: P6 <width> <height> <max value>, separated by whitespace and # comments
+    std::size_t at = 0;
+    auto next_number = [&](long& value) {
+        while (at < data.size()) {
+            if (data[at] == '#') {
+                while (at < data.size() && data[at] != '\n') {++at;}
+            }
+            else if (std::isspace(static_cast<unsigned char>(data[at]))) {++at;}
+            else {break;}
+        }
+        std::size_t start = at;
+        while (at < data.size() && std::isdigit(static_cast<unsigned char>(data[at]))) {++at;}
+        if (at == start || at - start > 9) {return false;}
+        value = std::atol(std::string(&data[start], at - start).c_str());
+        return true;
+    };
+
+    long width = 0, height = 0, max_value = 0;
+    if (data.size() < 2 || data[0] != 'P' || data[1] != '6') {
+        error = "not a binary PPM (P6) image";
+        return false;
+    }
+    at = 2;
+    if (!next_number(width) || !next_number(height) || !next_number(max_value) || at >= data.size()) {
+        error = "bad PPM header";
+        return false;
+    }
+    ++at;   // the single whitespace before the pixels
+
+    if (max_value != 255) {
+        error = "only 8 bit PPM images are supported";
+        return false;
+    }
+    if (width <= 0 || height <= 0 || width % TILE_PIXELS != 0 || height % TILE_PIXELS != 0) {
+        error = "sheet size is not a multiple of " + std::to_string(TILE_PIXELS) + " pixels";
+        return false;
+    }
+    if (data.size() - at < static_cast<std::size_t>(width) * height * 3) {
+        error = "sheet is cut short";
+        return false;
+    }
+
+    const unsigned char* pixels = reinterpret_cast<const unsigned char*>(data.data() + at);
+    int tiles_wide = static_cast<int>(width / TILE_PIXELS);
+    int tile_count = tiles_wide * static_cast<int>(height / TILE_PIXELS);
+
+    const std::size_t layer_bytes = static_cast<std::size_t>(TILE_PIXELS) * TILE_PIXELS * 4;
+    layers.assign(layer_bytes * LAYERS, 0);
+    for (int layer = 0; layer < LAYERS; ++layer) {
+        int tile = layer % tile_count;
+        int left = (tile % tiles_wide) * TILE_PIXELS;
+        int top = (tile / tiles_wide) * TILE_PIXELS;
+
+        for (int y = 0; y < TILE_PIXELS; ++y) {
+            // images are stored top row first, textures bottom row first
+            const unsigned char* row = pixels + ((static_cast<std::size_t>(top) + TILE_PIXELS - 1 - y) * width + left) * 3;
+            unsigned char* out = &layers[layer_bytes * layer + static_cast<std::size_t>(y) * TILE_PIXELS * 4];
+            for (int x = 0; x < TILE_PIXELS; ++x) {
+                out[x * 4 + 0] = row[x * 3 + 0];
+                out[x * 4 + 1] = row[x * 3 + 1];
+                out[x * 4 + 2] = row[x * 3 + 2];
+                out[x * 4 + 3] = 255;
+            }
+        }
+    }
+    return true;
+}
+
+unsigned int TileTextures::create_texture(const std::vector<unsigned char>& layers) {
+    unsigned int id = 0;
+    glGenTextures(1, &id);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, TILE_PIXELS, TILE_PIXELS, LAYERS, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, layers.data());
+
+    // mip levels are made per layer, so far away tiles only ever blend with themselves
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    return id;
+}
+
+void TileTextures::replace(unsigned int new_texture) {
+    glDeleteTextures(1, &texture);
+    texture = new_texture;
+}
+
+void TileTextures::bind(int unit) const {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+}
+
+#endif
+/* EOF */
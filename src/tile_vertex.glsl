@@ -1,10 +1,31 @@
 #version 330 core
 layout (location = 0) in vec3 pos;
+layout (location = 1) in vec2 offset;   // per-instance bottom left of the tile
+layout (location = 2) in vec2 size;     // per-instance (width, height) of the tile
+layout (location = 3) in vec3 color;    // per-instance color of the tile
+#ifdef TEXTURED
+layout (location = 4) in float layer;   // layer of the tile in the TileTextures array
+layout (location = 5) in vec2 uv;       // where in the tile image this corner is
+#endif
 
-uniform mat4 projection;
-uniform mat4 trans;
-uniform mat4 view;
+// shared by every program, written once per frame by CameraBuffer
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    mat4 view_projection;
+};
+
+#ifdef TEXTURED
+out vec3 tile_uv;
+#else
+out vec3 tile_color;
+#endif
 
 void main() {
-    gl_Position =  projection * view * trans * vec4(pos, 1.0);
-}
\ No newline at end of file
+#ifdef TEXTURED
+    tile_uv = vec3(uv, layer);
+#else
+    tile_color = color;
+#endif
+    gl_Position = view_projection * vec4(offset + pos.xy * size, pos.z, 1.0);
+}
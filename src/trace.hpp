@@ -0,0 +1,181 @@
+/// @brief Scoped CPU tracing, written out as a Chrome trace (open it in Perfetto or chrome://tracing).
+///
+///     TRACE_SCOPE("Player::move");    // times everything until the end of the enclosing block
+///     TRACE_DUMP("trace.json");       // write every zone recorded so far
+///
+/// Every thread records into its own fixed size ring buffer, so recording a zone takes no
+/// locks and never allocates. When a buffer is full the oldest zones are overwritten.
+/// Zone names must be string literals (or otherwise live forever), only the pointer is kept.
+///
+/// Tracing is only compiled in when PLATFORMER_TRACE is defined (cmake -DPLATFORMER_TRACE=ON).
+/// Without it both macros expand to nothing, and none of the code below is built
+#ifndef TRACE_ZONES
+#define TRACE_ZONES
+
+#ifdef PLATFORMER_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <iostream>
+
+namespace trace {
+
+/// @brief one finished zone
+struct Zone {
+    const char* name;
+    std::uint64_t start_ns;     // since the trace epoch
+    std::uint64_t duration_ns;
+};
+
+/// @brief zones kept per thread before the oldest are overwritten (about 1.5 MB each)
+const std::size_t ZONES_PER_THREAD = 1 << 16;
+
+/// @brief a single producer ring of zones. only the owning thread writes,
+/// dump() reads up to the published head
+class ThreadBuffer {
+public:
+    ThreadBuffer(int thread_id) : zones(ZONES_PER_THREAD), head(0), id(thread_id) {}
+
+    void push(const char* name, std::uint64_t start_ns, std::uint64_t duration_ns) {
+        std::uint64_t index = head.load(std::memory_order_relaxed);
+        zones[index & (ZONES_PER_THREAD - 1)] = Zone{name, start_ns, duration_ns};
+        head.store(index + 1, std::memory_order_release);
+    }
+
+    std::vector<Zone> zones;
+    std::atomic<std::uint64_t> head;    // zones ever pushed
+    int id;
+};
+
+/// @brief every thread's buffer, kept alive after the thread exits so its zones can still be dumped
+class Registry {
+public:
+    static Registry& instance() {
+        static Registry registry;
+        return registry;
+    }
+
+    /// @brief the calling thread's buffer, made the first time the thread records a zone
+    ThreadBuffer& local() {
+        thread_local ThreadBuffer* buffer = nullptr;
+        if (buffer == nullptr) {
+            std::lock_guard<std::mutex> lock(mutex);
+            buffers.emplace_back(new ThreadBuffer(static_cast<int>(buffers.size()) + 1));
+            buffer = buffers.back().get();
+        }
+        return *buffer;
+    }
+
+    /// @brief nanoseconds since the first zone of the run
+    std::uint64_t now() const {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - epoch).count());
+    }
+
+    /// @brief write every recorded zone as Chrome trace json. zones still being written
+    /// by other threads during the dump may be missed, so call it from a quiet point
+    /// @return false if the file could not be written
+    bool dump(const std::string& path);
+
+private:
+    Registry() : epoch(std::chrono::steady_clock::now()) {}
+
+    std::chrono::steady_clock::time_point epoch;
+    std::mutex mutex;                                   // only taken to add a thread or dump
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+};
+
+/// @brief records the time from construction to destruction as a zone
+class ScopedZone {
+public:
+    ScopedZone(const char* name) : name(name), start(Registry::instance().now()) {}
+    ~ScopedZone() {
+        Registry& registry = Registry::instance();
+        registry.local().push(name, start, registry.now() - start);
+    }
+
+    ScopedZone(const ScopedZone&) = delete;
+    ScopedZone& operator=(const ScopedZone&) = delete;
+
+private:
+    const char* name;
+    std::uint64_t start;
+};
+
+/// @brief write a string with the characters json needs escaped
+void write_json_string(std::FILE* file, const char* text) {
+    std::fputc('"', file);
+    for (const char* c = text; *c != '\0'; ++c) {
+        if (*c == '"' || *c == '\\') {std::fputc('\\', file);}
+        if (static_cast<unsigned char>(*c) < 0x20) {continue;}
+        std::fputc(*c, file);
+    }
+    std::fputc('"', file);
+}
+
+bool Registry::dump(const std::string& path) {
+    std::FILE* file = std::fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        std::cerr << "could not write trace: " << path << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    std::size_t written = 0;
+
+    for (const std::unique_ptr<ThreadBuffer>& buffer : buffers) {
+        // name the thread so the viewer shows something better than its id
+        std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s %d\"}}",
+                     first ? "" : ",\n", buffer->id, buffer->id == 1 ? "main" : "thread", buffer->id);
+        first = false;
+
+        // only the newest ZONES_PER_THREAD are still in the ring
+        std::uint64_t end = buffer->head.load(std::memory_order_acquire);
+        std::uint64_t begin = end > ZONES_PER_THREAD ? end - ZONES_PER_THREAD : 0;
+
+        for (std::uint64_t i = begin; i < end; ++i) {
+            const Zone& zone = buffer->zones[i & (ZONES_PER_THREAD - 1)];
+            std::fprintf(file, ",\n{\"name\":");
+            write_json_string(file, zone.name);
+            std::fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                         buffer->id, static_cast<double>(zone.start_ns) / 1000.0, static_cast<double>(zone.duration_ns) / 1000.0);
+            ++written;
+        }
+    }
+
+    std::fprintf(file, "\n]}\n");
+    std::fclose(file);
+
+    std::cout << "wrote " << written << " trace zones to " << path << std::endl;
+    return true;
+}
+
+}   // namespace trace
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+/// @brief time the rest of the enclosing block under the given name
+#define TRACE_SCOPE(name) trace::ScopedZone TRACE_CONCAT(trace_zone_, __LINE__)(name)
+
+/// @brief write everything recorded so far to a Chrome trace json file
+#define TRACE_DUMP(path) trace::Registry::instance().dump(path)
+
+#else
+
+#define TRACE_SCOPE(name)
+#define TRACE_DUMP(path) (static_cast<void>(0))
+
+#endif
+
+#endif
+/* EOF */
@@ -0,0 +1,55 @@
+/// @brief The rectangle of tiles the camera can currently see, used to cull
+/// everything outside the screen before it is submitted to the GPU
+#ifndef VIEW_RECT_STRUCT
+#define VIEW_RECT_STRUCT
+
+#include <cmath>
+#include <glm/glm.hpp>
+
+/// @brief a range of tiles, min is inclusive and max is exclusive
+struct ViewRect {
+    int min_x;
+    int min_y;
+    int max_x;
+    int max_y;
+
+    /// @brief true if the tile range [x0, x1) by [y0, y1) overlaps the rect
+    bool overlaps(int x0, int y0, int x1, int y1) const {
+        return x0 < max_x && x1 > min_x && y0 < max_y && y1 > min_y;
+    }
+
+    /// @brief shrink the rect so it does not go past the edges of a map
+    /// @param width width of the map in tiles
+    /// @param height height of the map in tiles
+    ViewRect clamped(int width, int height) const {
+        ViewRect rect = *this;
+        if (rect.min_x < 0) {rect.min_x = 0;}
+        if (rect.min_y < 0) {rect.min_y = 0;}
+        if (rect.max_x > width) {rect.max_x = width;}
+        if (rect.max_y > height) {rect.max_y = height;}
+        return rect;
+    }
+
+    bool operator==(const ViewRect& other) const {
+        return min_x == other.min_x && min_y == other.min_y && max_x == other.max_x && max_y == other.max_y;
+    }
+    bool operator!=(const ViewRect& other) const {return !(*this == other);}
+};
+
+/// @brief work out which tiles are on screen
+/// @param camera_pos the bottom left of the camera in world space
+/// @param view_size the (width, height) of the screen in world space
+/// @param tile_size the size of a tile in world space
+/// @param guard_band extra tiles kept around every edge, so nothing pops in at the border
+/// @return the visible tiles, not clamped to any map
+ViewRect visible_tiles(glm::vec2 camera_pos, glm::vec2 view_size, float tile_size, int guard_band = 1) {
+    ViewRect rect;
+    rect.min_x = static_cast<int>(std::floor(camera_pos.x / tile_size)) - guard_band;
+    rect.min_y = static_cast<int>(std::floor(camera_pos.y / tile_size)) - guard_band;
+    rect.max_x = static_cast<int>(std::ceil((camera_pos.x + view_size.x) / tile_size)) + guard_band;
+    rect.max_y = static_cast<int>(std::ceil((camera_pos.y + view_size.y) / tile_size)) + guard_band;
+    return rect;
+}
+
+#endif
+/* EOF */
@@ -0,0 +1,129 @@
+/// @brief A fixed set of threads that split one batch of work at a time between them, for the
+/// simulation step. The thread calling run() works on the batch too and only returns once every
+/// task is done, so the step reads as plain sequential code around each parallel part.
+///
+/// tasks are handed out from a shared counter, a thread that finishes early takes the next one.
+/// Between batches the threads sleep on a condition variable, they never spin
+#ifndef WORKER_POOL_CLASS
+#define WORKER_POOL_CLASS
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkerPool {
+public:
+    /// @param thread_count threads working on a batch, counting the caller of run().
+    /// 0 uses every core, 1 runs everything on the calling thread
+    explicit WorkerPool(int thread_count = 0);
+
+    /// @brief waits for the threads to stop, must not be called during run()
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    /// @brief threads working on a batch, counting the caller of run()
+    int thread_count() const {return static_cast<int>(threads.size()) + 1;}
+
+    /// @brief call task(0) to task(task_count - 1) spread over the threads, in no particular order,
+    /// and return once all of them are done. tasks must not touch the same data
+    void run(int task_count, const std::function<void(int)>& task);
+
+private:
+    /// @brief body of each thread, works on every batch until stopping
+    void run_worker();
+
+    /// @brief take tasks of the current batch until there are none left
+    void work();
+
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable batch_ready;    // a batch was started, or the pool is stopping
+    std::condition_variable batch_done;     // the last thread left the batch
+
+    // the current batch, set under the mutex before batch_ready
+    const std::function<void(int)>* task_function;
+    int task_total;
+    std::atomic<int> next_task;
+    int working;                // threads still in the batch
+    unsigned int batch;         // counts batches, so a thread never works the same one twice
+    bool stopping;
+};
+
+WorkerPool::WorkerPool(int thread_count) : task_function(nullptr), task_total(0), next_task(0), working(0), batch(0), stopping(false) {
+    if (thread_count <= 0) {thread_count = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));}
+
+    for (int i = 1; i < thread_count; ++i) {
+        threads.emplace_back(&WorkerPool::run_worker, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    batch_ready.notify_all();
+    for (std::thread& thread : threads) {thread.join();}
+}
+
+void WorkerPool::run(int task_count, const std::function<void(int)>& task) {
+    if (task_count <= 0) {return;}
+
+    // nothing to share, skip waking anyone
+    if (threads.empty() || task_count == 1) {
+        for (int i = 0; i < task_count; ++i) {task(i);}
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        task_function = &task;
+        task_total = task_count;
+        next_task.store(0, std::memory_order_relaxed);
+        working = static_cast<int>(threads.size());
+        ++batch;
+    }
+    batch_ready.notify_all();
+
+    work();
+
+    // the batch is only over once every thread has let go of the task
+    std::unique_lock<std::mutex> lock(mutex);
+    batch_done.wait(lock, [this] {return working == 0;});
+    task_function = nullptr;
+}
+
+void WorkerPool::run_worker() {
+    unsigned int last_batch = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            batch_ready.wait(lock, [this, last_batch] {return stopping || batch != last_batch;});
+            if (stopping) {return;}
+            last_batch = batch;
+        }
+
+        work();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--working == 0) {batch_done.notify_one();}
+    }
+}
+
+void WorkerPool::work() {
+    while (true) {
+        int i = next_task.fetch_add(1, std::memory_order_relaxed);
+        if (i >= task_total) {return;}
+        (*task_function)(i);
+    }
+}
+
+#endif
+/* EOF */
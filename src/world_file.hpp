@@ -0,0 +1,245 @@
+/// @brief A level split into square regions on disk, so it can be streamed in piece by piece
+/// instead of loaded whole (see StreamingWorld). Regions with no tiles take no space.
+///
+/// file layout, in the byte order of the machine that wrote it:
+///     header  - WorldFileHeader, 48 bytes
+///     index   - one WorldRegionEntry per region, row major from the bottom left
+///     regions - the cells of each stored region, in the block layout of a
+///               region_size x region_size TileGrid (see TileGrid::index)
+#ifndef WORLD_FILE
+#define WORLD_FILE
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "tile_grid.hpp"
+#include "hash.hpp"
+#include "map_binary.hpp"       // MAP_FILE_BYTE_ORDER, replace_file
+
+const char WORLD_FILE_MAGIC[4] = {'P', 'W', 'L', 'D'};
+const std::uint32_t WORLD_FILE_VERSION = 1;
+
+/// @brief region sides must be a multiple of this, MapChunk::SIZE, so a chunk never straddles two regions
+const int REGION_SIZE_MULTIPLE = 32;
+
+/// @brief tiles per region side unless asked otherwise
+const int DEFAULT_REGION_SIZE = 64;
+
+struct WorldFileHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t width;            // size of the whole level in tiles
+    std::uint32_t height;
+    std::uint32_t region_size;      // tiles per region side
+    std::uint32_t regions_wide;
+    std::uint32_t regions_high;
+    std::uint32_t block_bits;       // TileGrid::BLOCK_BITS the regions were laid out with
+    std::uint32_t byte_order;       // MAP_FILE_BYTE_ORDER as written by this machine
+    std::uint32_t reserved;
+    std::uint64_t header_hash;      // fnv1a of every field above this one
+};
+static_assert(sizeof(WorldFileHeader) == 48, "WorldFileHeader must stay 48 bytes, it is read straight from the file");
+
+struct WorldRegionEntry {
+    std::uint64_t offset;           // from the start of the file, 0 if the region is empty
+    std::uint64_t size;             // bytes of cells, 0 if the region is empty
+    std::uint64_t hash;             // fnv1a of the cells
+    std::uint32_t solid_count;      // tiles in the region that are not empty
+    std::uint32_t reserved;
+};
+static_assert(sizeof(WorldRegionEntry) == 32, "WorldRegionEntry must stay 32 bytes, it is read straight from the file");
+
+/// @brief the world file made from a csv, map.csv -> map.pworld
+std::string world_file_path(const std::string& csv_path) {
+    std::string compiled = compiled_map_path(csv_path);
+    return compiled.substr(0, compiled.size() - std::string(".pmap").size()) + ".pworld";
+}
+
+/// @brief split a grid into regions and save it as a world file
+/// @param region_size tiles per region side, must be a multiple of REGION_SIZE_MULTIPLE
+/// @return false if the file could not be written
+bool write_world_file(const std::string& path, const TileGrid& grid, int region_size = DEFAULT_REGION_SIZE);
+
+/// @brief the index of a world file, and reading its regions one at a time.
+/// open() and the index are used from one thread, read_region() from another is fine
+/// as long as only one thread reads regions at a time
+class WorldFile {
+public:
+    WorldFile() : file(nullptr) {}
+    ~WorldFile() {close();}
+
+    WorldFile(const WorldFile&) = delete;
+    WorldFile& operator=(const WorldFile&) = delete;
+
+    /// @brief read the header and index, no region cells are read yet
+    /// @return false if the file is missing or is not a world file
+    bool open(const std::string& path);
+    void close();
+
+    bool is_open() const {return file != nullptr;}
+
+    int width() const {return static_cast<int>(header.width);}
+    int height() const {return static_cast<int>(header.height);}
+    int region_size() const {return static_cast<int>(header.region_size);}
+    int regions_wide() const {return static_cast<int>(header.regions_wide);}
+    int regions_high() const {return static_cast<int>(header.regions_high);}
+
+    /// @brief the index entry of a region, by its position in the region grid (row major)
+    const WorldRegionEntry& entry(int region) const {return index[region];}
+
+    /// @brief read the cells of one region and check them against the index
+    /// @param region position in the region grid (row major)
+    /// @param cells [out] a region_size x region_size grid, empty regions come back all 0
+    /// @return false if the cells could not be read or did not match their hash
+    bool read_region(int region, TileGrid& cells);
+
+private:
+    std::FILE* file;
+    WorldFileHeader header;
+    std::vector<WorldRegionEntry> index;
+};
+
+bool write_world_file(const std::string& path, const TileGrid& grid, int region_size) {
+    if (region_size <= 0 || region_size % REGION_SIZE_MULTIPLE != 0) {
+        std::cerr << "region size " << region_size << " is not a multiple of " << REGION_SIZE_MULTIPLE << std::endl;
+        return false;
+    }
+
+    WorldFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, WORLD_FILE_MAGIC, sizeof(header.magic));
+    header.version = WORLD_FILE_VERSION;
+    header.width = static_cast<std::uint32_t>(grid.width());
+    header.height = static_cast<std::uint32_t>(grid.height());
+    header.region_size = static_cast<std::uint32_t>(region_size);
+    header.regions_wide = static_cast<std::uint32_t>((grid.width() + region_size - 1) / region_size);
+    header.regions_high = static_cast<std::uint32_t>((grid.height() + region_size - 1) / region_size);
+    header.block_bits = TileGrid::BLOCK_BITS;
+    header.byte_order = MAP_FILE_BYTE_ORDER;
+    header.header_hash = fnv1a(&header, offsetof(WorldFileHeader, header_hash));
+
+    std::size_t region_count = static_cast<std::size_t>(header.regions_wide) * header.regions_high;
+    std::vector<WorldRegionEntry> index(region_count);
+    std::memset(index.data(), 0, index.size() * sizeof(WorldRegionEntry));
+
+    std::string temp_path = path + ".tmp";
+    std::FILE* file = std::fopen(temp_path.c_str(), "wb");
+    if (file == nullptr) {
+        std::cerr << "could not write world: " << path << std::endl;
+        return false;
+    }
+
+    // the index is written again once the offsets are known
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && (index.empty() || std::fwrite(index.data(), sizeof(WorldRegionEntry), index.size(), file) == index.size());
+    std::uint64_t offset = sizeof(header) + index.size() * sizeof(WorldRegionEntry);
+
+    TileGrid region(region_size, region_size);
+    for (std::size_t i = 0; i < region_count && ok; ++i) {
+        int origin_x = static_cast<int>(i % header.regions_wide) * region_size;
+        int origin_y = static_cast<int>(i / header.regions_wide) * region_size;
+
+        region.resize(region_size, region_size);
+        std::uint32_t solid = 0;
+        for (int y = 0; y < region_size && origin_y + y < grid.height(); ++y) {
+            for (int x = 0; x < region_size && origin_x + x < grid.width(); ++x) {
+                TileGrid::TileId id = grid.at(origin_x + x, origin_y + y);
+                if (id == 0) {continue;}
+                region.set(x, y, id);
+                ++solid;
+            }
+        }
+        if (solid == 0) {continue;}     // empty regions are not stored
+
+        index[i].offset = offset;
+        index[i].size = region.memory_bytes();
+        index[i].hash = fnv1a(region.data(), region.memory_bytes());
+        index[i].solid_count = solid;
+
+        ok = std::fwrite(region.data(), 1, region.memory_bytes(), file) == region.memory_bytes();
+        offset += region.memory_bytes();
+    }
+
+    if (ok && !index.empty()) {
+        ok = std::fseek(file, static_cast<long>(sizeof(header)), SEEK_SET) == 0 &&
+             std::fwrite(index.data(), sizeof(WorldRegionEntry), index.size(), file) == index.size();
+    }
+    ok = std::fclose(file) == 0 && ok;
+
+    if (!ok) {std::remove(temp_path.c_str());}
+    if (!ok || !replace_file(temp_path, path)) {
+        std::cerr << "could not write world: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool WorldFile::open(const std::string& path) {
+    close();
+
+    file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        std::cerr << "could not open world: " << path << std::endl;
+        return false;
+    }
+
+    bool ok = std::fread(&header, sizeof(header), 1, file) == 1 &&
+              std::memcmp(header.magic, WORLD_FILE_MAGIC, sizeof(header.magic)) == 0 &&
+              header.header_hash == fnv1a(&header, offsetof(WorldFileHeader, header_hash)) &&
+              header.version == WORLD_FILE_VERSION && header.byte_order == MAP_FILE_BYTE_ORDER &&
+              header.block_bits == static_cast<std::uint32_t>(TileGrid::BLOCK_BITS) &&
+              header.region_size > 0 && header.region_size % REGION_SIZE_MULTIPLE == 0 &&
+              header.regions_wide == (header.width + header.region_size - 1) / header.region_size &&
+              header.regions_high == (header.height + header.region_size - 1) / header.region_size;
+
+    if (ok) {
+        index.resize(static_cast<std::size_t>(header.regions_wide) * header.regions_high);
+        ok = index.empty() || std::fread(index.data(), sizeof(WorldRegionEntry), index.size(), file) == index.size();
+    }
+
+    if (!ok) {
+        std::cerr << "not a world file, or made by an older version: " << path << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+void WorldFile::close() {
+    if (file == nullptr) {return;}
+    std::fclose(file);
+    file = nullptr;
+    index.clear();
+}
+
+bool WorldFile::read_region(int region, TileGrid& cells) {
+    int size = region_size();
+    const WorldRegionEntry& region_entry = index[region];
+
+    if (region_entry.size == 0) {
+        cells.resize(size, size);
+        return true;
+    }
+
+    std::size_t bytes = TileGrid::storage_size(size, size);
+    if (file == nullptr || region_entry.size != bytes) {return false;}
+
+    // read into a shared buffer the grid then views, rather than copying it again
+    std::shared_ptr<std::vector<TileGrid::TileId>> buffer = std::make_shared<std::vector<TileGrid::TileId>>(bytes);
+    if (std::fseek(file, static_cast<long>(region_entry.offset), SEEK_SET) != 0 ||
+        std::fread(buffer->data(), 1, bytes, file) != bytes ||
+        fnv1a(buffer->data(), bytes) != region_entry.hash) {
+        return false;
+    }
+
+    cells.view_cells(size, size, buffer->data(), std::shared_ptr<const void>(buffer, buffer->data()));
+    return true;
+}
+
+#endif
+/* EOF */